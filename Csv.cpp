@@ -0,0 +1,145 @@
+#include "Csv.h"
+#include <algorithm>
+#include <cctype>
+#include <clocale>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+namespace
+{
+  ///Minimum length of a part of a CSV file parsed by one thread.
+  const std::size_t minCsvChunkBytes=1<<20;
+}
+//-----------------------------------------------------------------------------
+std::vector<std::pair<const char*,const char*> > LibImageSegmentation::split_csv_chunks(const char *data,std::size_t size,int numofChunks)
+{
+  std::vector<std::pair<const char*,const char*> > ret;
+  const char *end=data+size;
+  const char *begin=data;
+  if(numofChunks<1) numofChunks=1;
+  std::size_t chunkSize=std::max(minCsvChunkBytes,size/numofChunks+1);
+  while(begin<end)
+  {
+    const char *chunkEnd=end;
+    if((std::size_t)(end-begin)>chunkSize)
+    {
+      chunkEnd=(const char*)std::memchr(begin+chunkSize-1,'\n',end-(begin+chunkSize-1));
+      chunkEnd=chunkEnd==nullptr?end:chunkEnd+1;
+    }
+    ret.push_back(std::make_pair(begin,chunkEnd));
+    begin=chunkEnd;
+  }
+  return(ret);
+}
+//-----------------------------------------------------------------------------
+long long LibImageSegmentation::parse_csv_integer(const char *begin,const char *end)
+{
+  while(begin<end && std::isspace((unsigned char)*begin)) begin++;
+  bool negative=false;
+  if(begin<end && (*begin=='+' || *begin=='-')) {negative=*begin=='-';begin++;}
+  //Out of range values are saturated to the range of long like by strtol (and so by atoi)
+  unsigned long long limit=negative?(unsigned long long)std::numeric_limits<long>::max()+1:std::numeric_limits<long>::max();
+  unsigned long long ret=0;
+  for(;begin<end && *begin>='0' && *begin<='9';begin++)
+  {
+    int digit=*begin-'0';
+    ret=ret>(limit-digit)/10?limit:10*ret+digit;
+  }
+  return(negative?-(long long)(ret-1)-1:(long long)ret);
+}
+//-----------------------------------------------------------------------------
+namespace
+{
+  /** Fast path of parse_csv_float for decimal numbers with at most 2^53 significand and a power of ten up to 1e22.
+   *  Both are exactly representable as double, so one multiplication (division) is correctly rounded
+   *  and the result is the same as the result of strtod.
+   *  @return False if the item is not such a number followed only by white characters.
+   */
+  bool parse_csv_float_fast(const char *begin,const char *end,double &res)
+  {
+    static const double powersOf10[]={1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+    const uint64_t maxSignificand=(uint64_t)1<<53;
+    while(begin<end && std::isspace((unsigned char)*begin)) begin++;
+    bool negative=false;
+    if(begin<end && (*begin=='+' || *begin=='-')) {negative=*begin=='-';begin++;}
+    uint64_t significand=0;
+    int exponent=0,numofDigits=0;
+    for(;begin<end && *begin>='0' && *begin<='9';begin++,numofDigits++)
+    {
+      significand=10*significand+(*begin-'0');
+      if(significand>maxSignificand) return(false);
+    }
+    if(begin<end && *begin=='.')
+    {
+      for(begin++;begin<end && *begin>='0' && *begin<='9';begin++,numofDigits++,exponent--)
+      {
+        significand=10*significand+(*begin-'0');
+        if(significand>maxSignificand) return(false);
+      }
+    }
+    if(numofDigits==0) return(false);
+    if(begin<end && (*begin=='e' || *begin=='E'))
+    {
+      const char *e=begin+1;
+      bool negativeExponent=false;
+      if(e<end && (*e=='+' || *e=='-')) {negativeExponent=*e=='-';e++;}
+      if(e<end && *e>='0' && *e<='9')
+      {
+        int value=0;
+        for(;e<end && *e>='0' && *e<='9';e++) if(value<100000) value=10*value+(*e-'0');
+        exponent+=negativeExponent?-value:value;
+        begin=e;
+      }
+    }
+    for(;begin<end;begin++) if(!std::isspace((unsigned char)*begin)) return(false);
+    if(exponent<-22 || exponent>22 || std::localeconv()->decimal_point[0]!='.') return(false);
+    res=exponent<0?(double)significand/powersOf10[-exponent]:(double)significand*powersOf10[exponent];
+    if(negative) res=-res;
+    return(true);
+  }
+}
+double LibImageSegmentation::parse_csv_float(const char *begin,const char *end)
+{
+  double ret;
+  if(parse_csv_float_fast(begin,end,ret)) return(ret);
+  char item[64];
+  std::size_t length=end-begin;
+  if(length<sizeof(item))
+  {
+    std::memcpy(item,begin,length);
+    item[length]='\0';
+    return(std::atof(item));
+  }
+  return(std::atof(std::string(begin,end).c_str()));
+}
+//-----------------------------------------------------------------------------
+namespace
+{
+  /** Replace the decimal point of the C locale (LC_NUMERIC) in number _text_ of _length_ characters by '.',
+   *  which is used by std::ostream with the classic locale.
+   *  @return The new length.
+   */
+  int use_classic_decimal_point(char *text,int length,std::size_t size)
+  {
+    const char *point=std::localeconv()->decimal_point;
+    if(length<0 || (std::size_t)length>=size || (point[0]=='.' && point[1]=='\0') || point[0]=='\0') return(length);
+    char *position=std::strstr(text,point);
+    if(position==nullptr) return(length);
+    std::size_t pointLength=std::strlen(point);
+    *position='.';
+    std::memmove(position+1,position+pointLength,text+length+1-(position+pointLength));
+    return(length-(int)pointLength+1);
+  }
+}
+//-----------------------------------------------------------------------------
+int LibImageSegmentation::format_csv_float(char *dst,std::size_t size,double value)
+{
+  return(use_classic_decimal_point(dst,std::snprintf(dst,size,"%.*g",6,value),size));
+}
+//-----------------------------------------------------------------------------
+int LibImageSegmentation::format_csv_float(char *dst,std::size_t size,long double value)
+{
+  return(use_classic_decimal_point(dst,std::snprintf(dst,size,"%.*Lg",6,value),size));
+}
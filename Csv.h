@@ -0,0 +1,173 @@
+#ifndef LIB_IMAGE_SEGMENTATION_CSV_H
+#define LIB_IMAGE_SEGMENTATION_CSV_H
+#include <cstddef>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+namespace LibImageSegmentation
+{
+  /** Split _size_ bytes of CSV text at _data_ into at most _numofChunks_ parts, which start at the beginnings of lines.
+   *  No part is shorter than 1 MB (except the last one), so small files are never split.
+   *  @return Pairs \[begin,end) of the parts in the order of the text.
+   */
+  std::vector<std::pair<const char*,const char*> > split_csv_chunks(const char *data,std::size_t size,int numofChunks);
+  ///Integer at the beginning of \[_begin_,_end_) parsed by the rules of atoi.
+  long long parse_csv_integer(const char *begin,const char *end);
+  ///Number at the beginning of \[_begin_,_end_) parsed by the rules of atof.
+  double parse_csv_float(const char *begin,const char *end);
+  ///Item \[_begin_,_end_) of a CSV file converted to _T_ (the same way as by atoi).
+  template <class T> typename std::enable_if<std::is_integral<T>::value,T>::type parse_csv_item(const char *begin,const char *end)
+  {
+    return((T)(int)parse_csv_integer(begin,end));
+  }
+  ///Item \[_begin_,_end_) of a CSV file converted to _T_ (the same way as by atof).
+  template <class T> typename std::enable_if<std::is_floating_point<T>::value,T>::type parse_csv_item(const char *begin,const char *end)
+  {
+    return((T)parse_csv_float(begin,end));
+  }
+  ///Item \[_begin_,_end_) of a CSV file converted to _T_ by its constructor from std::string.
+  template <class T> typename std::enable_if<!(std::is_integral<T>::value || std::is_floating_point<T>::value),T>::type
+  parse_csv_item(const char *begin,const char *end)
+  {
+    return(T(std::string(begin,end)));
+  }
+  /** Number of items on line \[_begin_,_end_) (without '\\n') of a CSV file, -1 if the line is blank.
+   *  @see parse_csv_chunk
+   */
+  inline int count_csv_items(const char *begin,const char *end,char delimiter)
+  {
+    int ret=0;
+    const char *firstEnd=nullptr;
+    for(const char *ch=begin;ch<end;ch++)
+    {
+      if(*ch!=delimiter) continue;
+      if(firstEnd==nullptr) firstEnd=ch;
+      ret++;
+    }
+    if(begin<end && end[-1]!=delimiter) ret++;
+    if(ret>1) return(ret);
+    if(firstEnd==nullptr) firstEnd=end;
+    for(const char *ch=begin;ch<firstEnd;ch++) if(*ch>(char)32) return(ret);
+    return(-1);
+  }
+  /** Write _value_ into _dst_ of _size_ bytes in the format of std::ostream with the classic locale (%g with precision 6),
+   *  the decimal point is '.' regardless of the C locale (setlocale). Returns the length.
+   */
+  int format_csv_float(char *dst,std::size_t size,double value);
+  ///@see format_csv_float(char *dst,std::size_t size,double value)
+  int format_csv_float(char *dst,std::size_t size,long double value);
+  /** Append _value_ to _dst_ in the same format as std::ostream::operator<< with the default flags and the classic locale.
+   *  Integers are converted without any library call.
+   */
+  template <class T> typename std::enable_if<std::is_integral<T>::value>::type append_csv_item(std::string &dst,T value)
+  {
+    using U=typename std::make_unsigned<T>::type;
+    char digits[24];
+    char *end=digits+sizeof(digits),*first=end;
+    U magnitude=value<0?U(0)-(U)value:(U)value;
+    do
+    {
+      *--first=(char)('0'+magnitude%10);
+      magnitude/=10;
+    }
+    while(magnitude!=0);
+    if(value<0) *--first='-';
+    dst.append(first,end-first);
+  }
+  ///@see append_csv_item(std::string &dst,T value)
+  template <class T> typename std::enable_if<std::is_floating_point<T>::value>::type append_csv_item(std::string &dst,T value)
+  {
+    char text[64];
+    int length=format_csv_float(text,sizeof(text),typename std::conditional<std::is_same<T,long double>::value,long double,double>::type(value));
+    dst.append(text,length);
+  }
+  ///@see append_csv_item(std::string &dst,T value)
+  template <class T> typename std::enable_if<!(std::is_integral<T>::value || std::is_floating_point<T>::value)>::type append_csv_item(std::string &dst,const T &value)
+  {
+    std::ostringstream out;
+    out << value;
+    dst+=out.str();
+  }
+  //-----------------------------------------------------------------------------
+  /** Part of a CSV file parsed by parse_csv_chunk.
+   *  The lines are counted from 1 within the part.
+   */
+  template <class T> struct CsvChunk
+  {
+    ///Problems found in the part.
+    enum class Error{None,BlankLine,DifferentWidth};
+    ///Items of all rows (non-blank lines), row by row.
+    std::vector<T> values;
+    ///Number of lines including the blank ones.
+    int numofLines=0;
+    ///Number of rows.
+    int numofRows=0;
+    ///Number of items of the first row, -1 if there are no rows.
+    int width=-1;
+    ///Line of the first row.
+    int firstRowLine=0;
+    ///The first problem, the parsing stops at it.
+    Error error=Error::None;
+    ///Line with the problem.
+    int errorLine=0;
+    ///Number of items on the line with the problem.
+    int errorWidth=0;
+  };
+  /** Parse the lines in \[_begin_,_end_) of a CSV file, the items of its rows (non-blank lines) are appended to _res_.values.
+   *  The lines are separated by '\\n' and the items by _delimiter_, an empty item after the last delimiter
+   *  of a line is not counted. A line is blank if it has no items or a single item without any character greater than space.
+   *  All rows must have the same number of items, the items of a line are appended only if the line is valid.
+   */
+  template <class T> void parse_csv_chunk(const char *begin,const char *end,char delimiter,bool ignoreBlankLines,CsvChunk<T> &res)
+  {
+    const char *line=begin;
+    while(line<end)
+    {
+      const char *lineEnd=(const char*)std::memchr(line,'\n',end-line);
+      if(lineEnd==nullptr) lineEnd=end;
+      res.numofLines++;
+      int numofItems=count_csv_items(line,lineEnd,delimiter);
+      if(numofItems<0)
+      {
+        if(!ignoreBlankLines)
+        {
+          res.error=CsvChunk<T>::Error::BlankLine;
+          res.errorLine=res.numofLines;
+          return;
+        }
+      }
+      else
+      {
+        if(res.width<0)
+        {
+          res.width=numofItems;
+          res.firstRowLine=res.numofLines;
+          //the rows usually have similar lengths, so the items of the part are counted by the length of the first row
+          res.values.reserve(res.values.size()+((std::size_t)(end-line)/(std::size_t)(lineEnd-line+1)+1)*numofItems);
+        }
+        else if(numofItems!=res.width)
+        {
+          res.error=CsvChunk<T>::Error::DifferentWidth;
+          res.errorLine=res.numofLines;
+          res.errorWidth=numofItems;
+          return;
+        }
+        const char *item=line;
+        for(int column=0;column<numofItems;column++)
+        {
+          const char *itemEnd=item;
+          while(itemEnd<lineEnd && *itemEnd!=delimiter) itemEnd++;
+          res.values.push_back(parse_csv_item<T>(item,itemEnd));
+          item=itemEnd+1;
+        }
+        res.numofRows++;
+      }
+      if(lineEnd==end) break;
+      line=lineEnd+1;
+    }
+  }
+}
+#endif
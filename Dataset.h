@@ -0,0 +1,148 @@
+#ifndef LIB_IMAGE_SEGMENTATION_DATASET_H
+#define LIB_IMAGE_SEGMENTATION_DATASET_H
+#include "ImageSegmentation.h"
+namespace LibImageSegmentation
+{
+  /** Set of segmentations/images of the same size stored in one contiguous block of memory.
+   *  Sample _i_ occupies width*height pixels starting at buffer\[_i_*width*height\] and its pixels are stored row by row,
+   *  so the whole set needs a single allocation. The samples are accessed through views (see ImageView), which provide
+   *  the read-only operations of ImageSegmentation (count_label, flood_fill, save, conv2 source, ...) without copying.
+   * @tparam T Underlying type.
+   * @tparam N Number of channels.
+   */
+  template <class T,int N> class Dataset
+  {
+    public:
+    ///@see ImageSegmentation::color_type
+    using color_type=typename __ImageTypes<T,N>::color_type;
+    ///View of one sample.
+    using sample_type=ImageView<T,N,RowMajor>;
+    ///Number of samples.
+    int numofSamples=0;
+    ///Width of the samples.
+    int width=0;
+    ///Height of the samples.
+    int height=0;
+    ///Pixels of all samples.
+    std::vector<color_type> buffer;
+    /** Constructor.
+     *  Creates an empty set.
+     */
+    Dataset(){}
+    /** Constructor.
+     *  Creates _numofSamples_ samples of size \[_width_,_height_\] filled by zeros.
+     */
+    Dataset(int numofSamples,int width,int height){this->reallocate(numofSamples,width,height);}
+    ///Number of samples.
+    int size()const{return(this->numofSamples);}
+    ///Number of pixels of one sample.
+    std::size_t sample_pixels()const{return((std::size_t)this->width*this->height);}
+    /** Change the number and the size of the samples, all pixels are set to 0.
+     */
+    void reallocate(int numofSamples,int width,int height)
+    {
+      this->numofSamples=std::max(0,numofSamples);
+      this->width=std::max(0,width);
+      this->height=std::max(0,height);
+      this->buffer.assign(this->numofSamples*this->sample_pixels(),color_type());
+    }
+    ///Remove all samples and free the memory.
+    void release()
+    {
+      this->numofSamples=0;
+      this->width=0;
+      this->height=0;
+      std::vector<color_type>().swap(this->buffer);
+    }
+    ///First pixel of sample _i_, pixel \[x,y\] of the sample is at index y*width+x.
+    color_type* sample_buffer(int i){return(this->buffer.data()+i*this->sample_pixels());}
+    ///@see sample_buffer(int i)
+    const color_type* sample_buffer(int i)const{return(this->buffer.data()+i*this->sample_pixels());}
+    ///View of sample _i_, valid until the set is reallocated.
+    sample_type operator[](int i)const{return(sample_type(this->sample_buffer(i),this->width,0,0,this->width,this->height));}
+    /** View of sample _i_.
+     *  @throw PositionException if there is no sample _i_.
+     */
+    sample_type at(int i)const
+    {
+      if(i<0 || i>=this->numofSamples)
+        throw(PositionException("Error: [Dataset::at]: Sample "+std::to_string(i)+" does not exist ("+std::to_string(this->numofSamples)+" samples)."));
+      return((*this)[i]);
+    }
+    /** Copy sample _i_ into _img_, e.g. for operations which modify the pixels.
+     */
+    template <class Layout> void copy_sample(int i,ImageSegmentation<T,N,Layout> &img)const
+    {
+      const color_type *src=this->sample_buffer(i);
+      img.reallocate(this->width,this->height);
+      img.traverse([&](int x,int y){img.data[x][y]=src[RowMajor::offset(x,y,this->width)];});
+    }
+    /** Copy _img_ into sample _i_.
+     *  @throw DimensionException if _img_ and the samples have different sizes.
+     */
+    template <class Layout> void set_sample(int i,const ImageView<T,N,Layout> &img)
+    {
+      if(img.width!=this->width || img.height!=this->height)
+        throw(DimensionException("Error: [Dataset::set_sample]: The image and the samples have different dimensions."));
+      color_type *dst=this->sample_buffer(i);
+      for(int y=0;y<this->height;y++)
+        for(int x=0;x<this->width;x++)
+          dst[RowMajor::offset(x,y,this->width)]=img.data[x][y];
+    }
+    ///@see set_sample(int i,const ImageView<T,N,Layout> &img)
+    template <class Layout> void set_sample(int i,const ImageSegmentation<T,N,Layout> &img){this->set_sample(i,img.view());}
+  };
+  //-----------------------------------------------------------------------------
+  /** Load MNIST dataset (segmentations) into one contiguous block of memory.
+   *  The samples which are not loaded (invalid indices) are filled by zeros.
+   *  @see load_mnist(const std::string&,const std::string&,std::vector<ImageSegmentation<T,N> >&,std::vector<int>&,int,std::vector<int>*,int)
+   *  Defined for underlying types DefaultTypes::int_type, uint8_t and uint16_t.
+   */
+  template <int N,class T> void load_mnist(const std::string &imagesFilename,
+                                           const std::string &labelsFilename,
+                                           Dataset<T,N> &resImages,
+                                           std::vector<int> &resLabels,
+                                           int threshold,
+                                           std::vector<int> *indices=nullptr,
+                                           int numofThreads=0);
+  /** Load MNIST dataset (single channel images) into one contiguous block of memory.
+   *  The samples which are not loaded (invalid indices) are filled by zeros.
+   *  @see load_mnist(const std::string&,const std::string&,std::vector<Image<T> >&,std::vector<int>&,std::vector<int>*,int)
+   *  Defined for underlying types DefaultTypes::int_type, uint8_t and uint16_t.
+   */
+  template <class T> void load_mnist(const std::string &imagesFilename,
+                                     const std::string &labelsFilename,
+                                     Dataset<T,1> &resImages,
+                                     std::vector<int> &resLabels,
+                                     std::vector<int> *indices=nullptr,
+                                     int numofThreads=0);
+  /** Load segmentations/images of the same size from files _filenames_ on _numofThreads_ threads.
+   *  @param res One sample per file, the size of the samples is given by the first file which is loaded.
+   *             The samples of the files which could not be loaded or have a different size are filled by zeros.
+   *  @see load_batch_each
+   */
+  template <class T,int N> std::vector<BatchLoadError> load_batch(const std::vector<std::string> &filenames,Dataset<T,N> &res,int numofThreads=0,
+                                                                  Verbose verbose=Verbose::Silent)
+  {
+    using image_type=ImageSegmentation<T,N,RowMajor>;
+    res.release();
+    std::vector<BatchLoadError> wrongSize;
+    std::vector<BatchLoadError> ret=load_batch_each<image_type>(filenames,[&](int i,image_type &img)
+    {
+      if(res.size()==0) res.reallocate(filenames.size(),img.width,img.height);
+      if(img.width==res.width && img.height==res.height) std::copy(img.buffer,img.buffer+res.sample_pixels(),res.sample_buffer(i));
+      else
+      {
+        wrongSize.push_back(BatchLoadError{i,filenames[i],"Error: [load_batch]: The image has size "+std::to_string(img.width)+"x"+
+                                           std::to_string(img.height)+", the samples have size "+std::to_string(res.width)+"x"+
+                                           std::to_string(res.height)+"."});
+      }
+    },numofThreads,0,verbose);
+    if(res.size()==0) res.reallocate(filenames.size(),0,0);
+    std::vector<BatchLoadError> merged(ret.size()+wrongSize.size());
+    std::merge(ret.begin(),ret.end(),wrongSize.begin(),wrongSize.end(),merged.begin(),
+               [](const BatchLoadError &e1,const BatchLoadError &e2){return(e1.index<e2.index);});
+    return(merged);
+  }
+}
+#endif
@@ -0,0 +1,192 @@
+#include "ImageSegmentation.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace LibImageSegmentation;
+namespace
+{
+  ///Decompose _n_ into radices 4, 2, 3 and 5, the remaining factor is returned.
+  int fft_radices(int n,std::vector<int> &radices)
+  {
+    radices.clear();
+    while(n%4==0) {radices.push_back(4);n/=4;}
+    while(n%2==0) {radices.push_back(2);n/=2;}
+    while(n%3==0) {radices.push_back(3);n/=3;}
+    while(n%5==0) {radices.push_back(5);n/=5;}
+    return(n);
+  }
+}
+//-----------------------------------------------------------------------------
+int LibImageSegmentation::fft_size(int n)
+{
+  std::vector<int> radices;
+  n=std::max(n,1);
+  while(fft_radices(n,radices)!=1) n++;
+  return(n);
+}
+//-----------------------------------------------------------------------------
+LibImageSegmentation::FftPlan::FftPlan(int n) : n(n)
+{
+  if(n<1 || fft_radices(n,this->radices)!=1)
+    throw(DimensionException("Error: [FftPlan::FftPlan]: The length "+std::to_string(n)+" has a prime factor greater than 5."));
+  this->twiddles.resize(n);
+  for(int k=0;k<n;k++) this->twiddles[k]=std::polar(1.0,-2*std::acos(-1.0)*k/n);
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::FftPlan::transform(std::complex<double> *data,bool inverse,std::complex<double> *work)const
+{
+  using complex=std::complex<double>;
+  //inverse transform by conjugation: ifft(x)=conj(fft(conj(x)))/n
+  if(inverse) for(int i=0;i<this->n;i++) data[i]=std::conj(data[i]);
+  complex *src=data,*dst=work;
+  const complex *w=this->twiddles.data();
+  int ns=1;
+  for(auto &&radix: this->radices)
+  {
+    int m=this->n/radix,step=this->n/(ns*radix);
+    complex v[5],x[5];
+    for(int g=0;g<m/ns;g++)
+    {
+      for(int k=0;k<ns;k++)
+      {
+        int j=g*ns+k;
+        v[0]=src[j];
+        for(int r=1;r<radix;r++) v[r]=src[j+r*m]*w[k*r*step];
+        if(radix==4)
+        {
+          complex t0=v[0]+v[2],t1=v[0]-v[2],t2=v[1]+v[3],t3=v[1]-v[3];
+          t3=complex(t3.imag(),-t3.real());
+          x[0]=t0+t2;
+          x[1]=t1+t3;
+          x[2]=t0-t2;
+          x[3]=t1-t3;
+        }
+        else if(radix==2)
+        {
+          x[0]=v[0]+v[1];
+          x[1]=v[0]-v[1];
+        }
+        else
+        {
+          for(int q=0;q<radix;q++)
+          {
+            x[q]=v[0];
+            for(int r=1;r<radix;r++) x[q]+=v[r]*w[(q*r%radix)*m];
+          }
+        }
+        complex *d=dst+g*ns*radix+k;
+        for(int r=0;r<radix;r++) d[r*ns]=x[r];
+      }
+    }
+    ns*=radix;
+    std::swap(src,dst);
+  }
+  if(src!=data) std::copy(src,src+this->n,data);
+  if(inverse)
+  {
+    double scale=1.0/this->n;
+    for(int i=0;i<this->n;i++) data[i]=std::conj(data[i])*scale;
+  }
+}
+//-----------------------------------------------------------------------------
+LibImageSegmentation::FftConvolution::FftConvolution(const std::vector<double> &filter,int filterWidth,int filterHeight,int filterCenterX,int filterCenterY,
+                                                     int width,int height) :
+  filterWidth(filterWidth),filterHeight(filterHeight),filterCenterX(filterCenterX),filterCenterY(filterCenterY),width(width),height(height),
+  rowPlan(std::min(fft_size(std::max(4*(filterWidth-1),64)),fft_size(width+filterWidth-1))),
+  columnPlan(std::min(fft_size(std::max(4*(filterHeight-1),64)),fft_size(height+filterHeight-1)))
+{
+  if(filterWidth<1 || filterHeight<1 || filter.size()!=(std::size_t)filterWidth*filterHeight)
+    throw(DimensionException("Error: [FftConvolution::FftConvolution]: Invalid dimensions of the filter."));
+  int fftWidth=this->rowPlan.size(),fftHeight=this->columnPlan.size();
+  this->blockWidth=fftWidth-filterWidth+1;
+  this->blockHeight=fftHeight-filterHeight+1;
+  this->filterSpectrum.assign((std::size_t)fftWidth*fftHeight,0.0);
+  for(int y=0;y<filterHeight;y++)
+    for(int x=0;x<filterWidth;x++)
+      this->filterSpectrum[(std::size_t)y*fftWidth+x]=filter[(std::size_t)y*filterWidth+x];
+  std::vector<std::complex<double> > work;
+  this->transform(this->filterSpectrum,filterHeight,false,work);
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::FftConvolution::transform(std::vector<std::complex<double> > &data,int numofRows,bool inverse,std::vector<std::complex<double> > &work)const
+{
+  int fftWidth=this->rowPlan.size(),fftHeight=this->columnPlan.size();
+  work.resize(2*std::max(fftWidth,fftHeight));
+  std::complex<double> *column=work.data()+fftHeight;
+  //the rows after numofRows are zero, so are their transforms
+  for(int y=0;y<numofRows;y++) this->rowPlan.transform(data.data()+(std::size_t)y*fftWidth,inverse,work.data());
+  for(int x=0;x<fftWidth;x++)
+  {
+    for(int y=0;y<fftHeight;y++) column[y]=data[(std::size_t)y*fftWidth+x];
+    this->columnPlan.transform(column,inverse,work.data());
+    for(int y=0;y<fftHeight;y++) data[(std::size_t)y*fftWidth+x]=column[y];
+  }
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::FftConvolution::convolve(const std::function<void(int,double*)> &readRow,const std::function<void(int,const double*)> &writeRow,
+                                                    int numofThreads)const
+{
+  int fftWidth=this->rowPlan.size(),fftHeight=this->columnPlan.size();
+  int numofBlocks=(this->width+this->blockWidth-1)/this->blockWidth;
+  int numofPairs=(numofBlocks+1)/2;
+  //rows [top,top+blockHeight) of the image, rows [top,top+fftHeight) of the full convolution
+  std::vector<double> band((std::size_t)this->blockHeight*this->width);
+  std::vector<double> sum((std::size_t)fftHeight*this->width,0.0);
+  //pairs of blocks 2k and 2k+1 are transformed at once, the first block in the real part and the second one in the imaginary part
+  auto convolve_pair=[&](int k,int numofRows,std::vector<std::complex<double> > &block,std::vector<std::complex<double> > &work)
+  {
+    int numofResultRows=std::min(fftHeight,numofRows+this->filterHeight-1);
+    int x1=2*k*this->blockWidth,x2=x1+this->blockWidth;
+    int w1=std::min(this->blockWidth,this->width-x1),w2=std::max(0,std::min(this->blockWidth,this->width-x2));
+    block.assign((std::size_t)fftWidth*fftHeight,0.0);
+    for(int r=0;r<numofRows;r++)
+    {
+      const double *row=band.data()+(std::size_t)r*this->width;
+      std::complex<double> *dst=block.data()+(std::size_t)r*fftWidth;
+      for(int q=0;q<w1;q++) dst[q].real(row[x1+q]);
+      for(int q=0;q<w2;q++) dst[q].imag(row[x2+q]);
+    }
+    this->transform(block,numofRows,false,work);
+    for(std::size_t i=0;i<block.size();i++) block[i]*=this->filterSpectrum[i];
+    this->transform(block,fftHeight,true,work);
+    //column q of the block is column x1+q (x2+q) of the full convolution and column x1+q-filterCenterX of the result
+    for(int r=0;r<numofResultRows;r++)
+    {
+      double *dst=sum.data()+(std::size_t)r*this->width;
+      const std::complex<double> *src=block.data()+(std::size_t)r*fftWidth;
+      int q1=std::max(0,this->filterCenterX-x1),q2=std::min(w1+this->filterWidth-1,this->width+this->filterCenterX-x1);
+      for(int q=q1;q<q2;q++) dst[x1+q-this->filterCenterX]+=src[q].real();
+      if(w2==0) continue;
+      q1=std::max(0,this->filterCenterX-x2);
+      q2=std::min(w2+this->filterWidth-1,this->width+this->filterCenterX-x2);
+      for(int q=q1;q<q2;q++) dst[x2+q-this->filterCenterX]+=src[q].imag();
+    }
+  };
+  //the results of pairs k and k+2 do not overlap (blockWidth>=3*(filterWidth-1)+1 if there are more pairs), so the even
+  //and then the odd pairs are added to sum in parallel and the result does not depend on the number of threads
+  int numofRanges=std::max(1,std::min(resolve_numof_threads(numofThreads),(numofPairs+1)/2));
+  std::vector<std::vector<std::complex<double> > > blocks(numofRanges),works(numofRanges);
+  for(int top=0;top<this->height;top+=this->blockHeight)
+  {
+    int numofRows=std::min(this->blockHeight,this->height-top);
+    for(int r=0;r<numofRows;r++) readRow(top+r,band.data()+(std::size_t)r*this->width);
+    for(int parity=0;parity<2;parity++)
+    {
+      parallel_ranges((numofPairs-parity+1)/2,numofRanges,[&](int t,int begin,int end)
+      {
+        for(int i=begin;i<end;i++) convolve_pair(2*i+parity,numofRows,blocks[t],works[t]);
+      });
+    }
+    //the following bands do not change the first blockHeight rows, row v of the full convolution is row v-filterCenterY of the result
+    bool last=top+this->blockHeight>=this->height;
+    int numofFinished=last?fftHeight:this->blockHeight;
+    for(int r=0;r<numofFinished;r++)
+    {
+      int y=top+r-this->filterCenterY;
+      if(y>=0 && y<this->height) writeRow(y,sum.data()+(std::size_t)r*this->width);
+    }
+    std::size_t shift=(std::size_t)this->blockHeight*this->width;
+    std::copy(sum.begin()+shift,sum.end(),sum.begin());
+    std::fill(sum.end()-shift,sum.end(),0.0);
+  }
+}
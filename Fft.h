@@ -0,0 +1,76 @@
+#ifndef LIB_IMAGE_SEGMENTATION_FFT_H
+#define LIB_IMAGE_SEGMENTATION_FFT_H
+#include <complex>
+#include <functional>
+#include <vector>
+namespace LibImageSegmentation
+{
+  /** Filters with at least this number of pixels, which are not separable, are convolved by FftConvolution
+   *  in conv2 (Conv2Method::Auto).
+   */
+  const int fftConv2MinFilterPixels=900;
+  ///Smallest number >=_n_ of the form 2^a*3^b*5^c, the sizes of FftPlan.
+  int fft_size(int n);
+  //-----------------------------------------------------------------------------
+  /** Discrete Fourier transform of _n_ complex numbers, where _n_ has no prime factors other than 2, 3 and 5.
+   *  Mixed-radix (4, 2, 3, 5) Stockham algorithm with precomputed twiddle factors.
+   */
+  class FftPlan
+  {
+    int n=0;
+    std::vector<int> radices;
+    std::vector<std::complex<double> > twiddles;
+    public:
+    /** Constructor.
+     *  @throw DimensionException if _n_ is not positive or it has a prime factor greater than 5 (see fft_size).
+     */
+    FftPlan(int n);
+    ///Length of the transformed sequences.
+    int size()const{return(this->n);}
+    /** Transform _data_ in place.
+     *  @param inverse Computes the inverse transform including the 1/_n_ scaling.
+     *  @param work Buffer for _n_ numbers.
+     */
+    void transform(std::complex<double> *data,bool inverse,std::complex<double> *work)const;
+  };
+  //-----------------------------------------------------------------------------
+  /** Convolution of an image with a (large) filter by FFT and overlap-add.
+   *  The image is split into bands of rows and the bands into blocks, each block is convolved through a 2D FFT of fixed size
+   *  (about four times the filter, two blocks at once as the real and imaginary part) and the results are added. Only one
+   *  band of the image and of the result is kept in memory besides the block, so the memory does not depend on the height
+   *  of the image.
+   */
+  class FftConvolution
+  {
+    int filterWidth;
+    int filterHeight;
+    int filterCenterX;
+    int filterCenterY;
+    int width;
+    int height;
+    int blockWidth;
+    int blockHeight;
+    FftPlan rowPlan;
+    FftPlan columnPlan;
+    ///Spectrum of the zero-padded filter, row-major.
+    std::vector<std::complex<double> > filterSpectrum;
+    void transform(std::vector<std::complex<double> > &data,int numofRows,bool inverse,std::vector<std::complex<double> > &work)const;
+    public:
+    /** Constructor.
+     *  Prepares the convolution of images of size \[_width_,_height_\] with _filter_.
+     *  @param filter Pixel \[x,y\] of the filter is _filter_\[y*_filterWidth_+x\].
+     *  @param filterCenterX,filterCenterY Coordinates of the center pixel of the filter.
+     */
+    FftConvolution(const std::vector<double> &filter,int filterWidth,int filterHeight,int filterCenterX,int filterCenterY,int width,int height);
+    /** Compute the convolution conv2(image,filter,'same') (zero-padding).
+     *  @param readRow Called as _readRow_(y,dst) for rows y=0,...,height-1 in this order, it stores row _y_ of the image
+     *         into _dst_ (width numbers).
+     *  @param writeRow Called as _writeRow_(y,src) for rows y=0,...,height-1 in this order, _src_ is row _y_ of the result.
+     *  @param numofThreads Number of threads, which transform the blocks of a band, values <=0 mean the number of hardware
+     *         threads. _readRow_ and _writeRow_ are called only by the calling thread.
+     */
+    void convolve(const std::function<void(int,double*)> &readRow,const std::function<void(int,const double*)> &writeRow,
+                  int numofThreads=0)const;
+  };
+}
+#endif
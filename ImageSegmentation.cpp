@@ -1,5 +1,7 @@
 #include <CImg.h>
 #include "ImageSegmentation.h"
+#include "Dataset.h"
+#include "Scanline.h"
 LibImageSegmentation::BadSegmentationFormatException::BadSegmentationFormatException(int paletteSpectrum,int cimgSpectrum,const std::string &filename) 
 {
   this->message=std::string("Unexpected number of channels, expected 1 or ")+
@@ -65,12 +67,15 @@ namespace __Dummy
   template <class T,int N> class __PrivateCImgWrapper
   {
     __PrivateCImgWrapper(const std::string &filename){}
+    __PrivateCImgWrapper(const std::string &filename,int x1,int y1,int x2,int y2,int step){}
     __PrivateCImgWrapper(int width,int height,int spectrum){}
     __PrivateCImgWrapper(int spectrum,const std::string &text,T *foregroundColor,T *backgroundColor,int size){}
     ~__PrivateCImgWrapper(){}
     T _get(int x,int y,int c)const{return(T{});}
     void get(int x,int y,std::vector<T> &res)const{}
     double get_average(int x,int y)const{return(0);}
+    const T* plane(int c)const{return(nullptr);}
+    T* plane(int c){return(nullptr);}
     void set(int x,int y,int c,T value){}
     void resize(double m,int cimgInterpolationType=1){}
     void save(const std::string &filename)const{}
@@ -96,6 +101,39 @@ INST_PCIW_CONSTRUCTOR(uint8_t,__PrivateCImgWrapper(const std::string &filename),
 INST_PCIW_CONSTRUCTOR(uint16_t,__PrivateCImgWrapper(const std::string &filename),__LINE__);
 INST_PCIW_CONSTRUCTOR(uint32_t,__PrivateCImgWrapper(const std::string &filename),__LINE__);
 INST_PCIW_CONSTRUCTOR(uint64_t,__PrivateCImgWrapper(const std::string &filename),__LINE__);
+//-----------------------------------------------------------------------------
+template <class T> LibImageSegmentation::__PrivateCImgWrapper<T>::__PrivateCImgWrapper(const std::string &filename,int x1,int y1,int x2,int y2,int step)
+{
+  std::unique_ptr<ScanlineDecoder> decoder=ScanlineDecoder::open(filename,ScanlineFormat::Auto,std::is_floating_point<T>::value,',',true);
+  step=std::max(step,1);
+  x1=std::max(x1,0);
+  y1=std::max(y1,0);
+  x2=std::min(x2,decoder->width-1);
+  y2=std::min(y2,decoder->height-1);
+  int width=x1<=x2?(x2-x1)/step+1:0,height=y1<=y2?(y2-y1)/step+1:0,spectrum=decoder->spectrum;
+  //The pixels are decoded before the CImg is allocated, the destructor is not called if the decoder throws
+  std::size_t numofSamples=(std::size_t)width*height*spectrum;
+  std::vector<T> samples(numofSamples);
+  if(numofSamples>0)
+  {
+    std::vector<char> pixels(numofSamples*decoder->sampleBytes);
+    decoder->read_region(x1,y1,x2,y2,step,pixels.data());
+    if(!convert_samples(pixels.data(),decoder->sampleFormat,decoder->sampleBytes,samples.data(),numofSamples))
+      throw(CoreException("Error [__PrivateCImgWrapper]: "+filename+" has an unsupported sample format."));
+  }
+  this->cimg=new cimg_library::CImg<T>(width,height,1,spectrum);
+  this->init_dimensions(width,height,spectrum);
+  for(int c=0;c<spectrum;c++)
+  {
+    T *dst=this->plane(c);
+    for(std::size_t i=0;i<(std::size_t)width*height;i++) dst[i]=samples[i*spectrum+c];
+  }
+}
+INST_PCIW_CONSTRUCTOR_DEFAULT(__PrivateCImgWrapper(const std::string &filename,int x1,int y1,int x2,int y2,int step));
+INST_PCIW_CONSTRUCTOR(uint8_t,__PrivateCImgWrapper(const std::string &filename,int x1,int y1,int x2,int y2,int step),__LINE__);
+INST_PCIW_CONSTRUCTOR(uint16_t,__PrivateCImgWrapper(const std::string &filename,int x1,int y1,int x2,int y2,int step),__LINE__);
+INST_PCIW_CONSTRUCTOR(uint32_t,__PrivateCImgWrapper(const std::string &filename,int x1,int y1,int x2,int y2,int step),__LINE__);
+INST_PCIW_CONSTRUCTOR(uint64_t,__PrivateCImgWrapper(const std::string &filename,int x1,int y1,int x2,int y2,int step),__LINE__);
 
 //-----------------------------------------------------------------------------
 template <class T> LibImageSegmentation::__PrivateCImgWrapper<T>::__PrivateCImgWrapper(int width,int height,int spectrum)
@@ -178,6 +216,36 @@ INST_PCIW_METHOD(double,uint16_t,get_average(int x,int y)const,__LINE__);
 INST_PCIW_METHOD(double,uint32_t,get_average(int x,int y)const,__LINE__);
 INST_PCIW_METHOD(double,uint64_t,get_average(int x,int y)const,__LINE__);
 
+//-----------------------------------------------------------------------------
+template <class T> const T* LibImageSegmentation::__PrivateCImgWrapper<T>::plane(int c)const
+{
+  auto &d=*static_cast<cimg_library::CImg<T> *>(this->cimg);
+  if(c<0 || c>=d.spectrum()) return(nullptr);
+  return(d.data(0,0,0,c));
+}
+template const LibImageSegmentation::DefaultTypes::int_type* LibImageSegmentation::__PrivateCImgWrapper<LibImageSegmentation::DefaultTypes::int_type>::plane(int c)const;
+template const LibImageSegmentation::DefaultTypes::uint_type* LibImageSegmentation::__PrivateCImgWrapper<LibImageSegmentation::DefaultTypes::uint_type>::plane(int c)const;
+template const LibImageSegmentation::DefaultTypes::float_type* LibImageSegmentation::__PrivateCImgWrapper<LibImageSegmentation::DefaultTypes::float_type>::plane(int c)const;
+INST_PCIW_METHOD(const uint8_t*,uint8_t,plane(int c)const,__LINE__);
+INST_PCIW_METHOD(const uint16_t*,uint16_t,plane(int c)const,__LINE__);
+INST_PCIW_METHOD(const uint32_t*,uint32_t,plane(int c)const,__LINE__);
+INST_PCIW_METHOD(const uint64_t*,uint64_t,plane(int c)const,__LINE__);
+
+//-----------------------------------------------------------------------------
+template <class T> T* LibImageSegmentation::__PrivateCImgWrapper<T>::plane(int c)
+{
+  auto &d=*static_cast<cimg_library::CImg<T> *>(this->cimg);
+  if(c<0 || c>=d.spectrum()) return(nullptr);
+  return(d.data(0,0,0,c));
+}
+template LibImageSegmentation::DefaultTypes::int_type* LibImageSegmentation::__PrivateCImgWrapper<LibImageSegmentation::DefaultTypes::int_type>::plane(int c);
+template LibImageSegmentation::DefaultTypes::uint_type* LibImageSegmentation::__PrivateCImgWrapper<LibImageSegmentation::DefaultTypes::uint_type>::plane(int c);
+template LibImageSegmentation::DefaultTypes::float_type* LibImageSegmentation::__PrivateCImgWrapper<LibImageSegmentation::DefaultTypes::float_type>::plane(int c);
+INST_PCIW_METHOD(uint8_t*,uint8_t,plane(int c),__LINE__);
+INST_PCIW_METHOD(uint16_t*,uint16_t,plane(int c),__LINE__);
+INST_PCIW_METHOD(uint32_t*,uint32_t,plane(int c),__LINE__);
+INST_PCIW_METHOD(uint64_t*,uint64_t,plane(int c),__LINE__);
+
 //-----------------------------------------------------------------------------
 template <class T> void LibImageSegmentation::__PrivateCImgWrapper<T>::set(int x,int y,int c,T value)
 {
@@ -222,11 +290,66 @@ INST_PCIW_METHOD(void,uint32_t,save(const std::string &filename)const,__LINE__);
 INST_PCIW_METHOD(void,uint64_t,save(const std::string &filename)const,__LINE__);
 
 //-----------------------------------------------------------------------------
-int get_index_position(int index,const std::vector<int> *indices)
+namespace
 {
-  int ret=-1;
-  for(int i=0;i<(int)indices->size();i++) if(indices->at(i)==index) {ret=i;break;}
-  return(ret);
+  ///Size of the header of an MNIST file with images.
+  const std::size_t mnistImagesHeaderSize=16;
+  ///Size of the header of an MNIST file with labels.
+  const std::size_t mnistLabelsHeaderSize=8;
+  ///Number of images decoded by one task of the parallel loader.
+  const int mnistImagesPerTask=256;
+  ///Big endian 32-bit integer of an MNIST header.
+  int read_mnist_int(const char *src)
+  {
+    const unsigned char *s=(const unsigned char*)src;
+    return((int)(((uint32_t)s[0]<<24)|((uint32_t)s[1]<<16)|((uint32_t)s[2]<<8)|(uint32_t)s[3]));
+  }
+  /** Map MNIST file _filename_ into memory, so the samples which are not loaded are never read.
+   *  @param size Size of the file in bytes.
+   *  @return nullptr if the file is empty.
+   */
+  std::unique_ptr<LibImageSegmentation::MappedFile> map_mnist_file(const std::string &filename,const std::string &function,std::size_t &size)
+  {
+    std::ifstream in(filename,std::ios::binary|std::ios::ate);
+    if(!in.good()) throw(LibImageSegmentation::CoreException("Error ["+function+"]: "+filename+" does not exist or is not readable."));
+    size=in.tellg();
+    in.close();
+    if(size==0) return(nullptr);
+    return(std::unique_ptr<LibImageSegmentation::MappedFile>(new LibImageSegmentation::MappedFile(filename,LibImageSegmentation::MappedFile::Access::ReadOnly)));
+  }
+  /** Inverse of _indices_ for a file with _numofSamples_ samples.
+   *  @return Position of the first occurrence of each sample in _indices_, -1 for the samples which are not loaded.
+   */
+  std::vector<int> mnist_positions(int numofSamples,const std::vector<int> &indices)
+  {
+    std::vector<int> ret(numofSamples,-1);
+    for(int i=0;i<(int)indices.size();i++)
+    {
+      int index=indices[i];
+      if(index>=0 && index<numofSamples && ret[index]<0) ret[index]=i;
+    }
+    return(ret);
+  }
+  /** Pairs (sample in the file,position in the result) of the samples to be loaded.
+   *  @param numofResults Size of the result if _indices_==nullptr.
+   */
+  std::vector<std::pair<int,int> > mnist_samples(int numofSamples,int numofResults,const std::vector<int> *indices)
+  {
+    std::vector<std::pair<int,int> > ret;
+    if(indices==nullptr)
+    {
+      for(int i=0;i<std::min(numofSamples,numofResults);i++) ret.push_back(std::make_pair(i,i));
+      return(ret);
+    }
+    std::vector<int> positions=mnist_positions(numofSamples,*indices);
+    ret.reserve(indices->size());
+    for(int i=0;i<(int)indices->size();i++)
+    {
+      int index=(*indices)[i];
+      if(index>=0 && index<numofSamples && positions[index]==i) ret.push_back(std::make_pair(index,i));
+    }
+    return(ret);
+  }
 }
 //------------------------------------------------------------------------------
 void _load_mnist_labels(const std::string &labelsFilename,std::vector<int> &resLabels,std::vector<int> *indices)
@@ -234,170 +357,213 @@ void _load_mnist_labels(const std::string &labelsFilename,std::vector<int> &resL
   resLabels.clear();
   if(labelsFilename.size()>0 && (indices==nullptr || indices->size()>0))
   {
-    char *buffer=new char[4];
-    int i,numofLabels,index;
-    std::ifstream in(labelsFilename,std::ifstream::binary);
-    if(in.good()) 
-    {
-      in.read (buffer,4);//magic number
-      in.read (buffer,4);//number of images
-      numofLabels=(unsigned char)(buffer[3])+
-                  256*((unsigned char)(buffer[2]))+
-                  256*256*(unsigned char)(buffer[1])+
-                  256*256*256*(unsigned char)(buffer[0]);
-      
-      delete []buffer;
-      if(numofLabels>0)
-      {
-        if(indices==nullptr) resLabels.assign(numofLabels,-0xFFFFFF);
-        else resLabels.assign(indices->size(),-0xFFFFFF);
-
-        buffer=new char[numofLabels];
-
-        in.read(buffer,numofLabels);
-        if(in.gcount()!=numofLabels) std::cerr << "Warning [_load_mnist_labels]: " << labelsFilename << " is damaged, contains only " << in.gcount() << " labels, " << numofLabels << " expected.\n";
-        
-        for(i=0;i<in.gcount();i++) 
-        {
-          if(indices==nullptr) index=i;
-          else index=get_index_position(i,indices);
-          if(index>=0) resLabels[index]=(int)((unsigned char)buffer[i]);
-        }
-      }
-      else
-      {
-        throw(LibImageSegmentation::CoreException("Error [_load_mnist_labels]:  " + labelsFilename + ", invalid number of labels: "+std::to_string(numofLabels)+"."));
-      }
-    }
-    else
+    std::size_t size;
+    std::unique_ptr<LibImageSegmentation::MappedFile> file=map_mnist_file(labelsFilename,"_load_mnist_labels",size);
+    int numofLabels=size>=mnistLabelsHeaderSize?read_mnist_int(file->data()+4):0;
+    if(numofLabels<=0)
     {
-      throw(LibImageSegmentation::CoreException("Error [_load_mnist_labels]: " + labelsFilename + " does not exist or is not readable."));
+      throw(LibImageSegmentation::CoreException("Error [_load_mnist_labels]:  " + labelsFilename + ", invalid number of labels: "+std::to_string(numofLabels)+"."));
     }
-    delete []buffer; 
+    int numofStored=(int)std::min(size-mnistLabelsHeaderSize,(std::size_t)numofLabels);
+    if(numofStored!=numofLabels) std::cerr << "Warning [_load_mnist_labels]: " << labelsFilename << " is damaged, contains only " << numofStored << " labels, " << numofLabels << " expected.\n";
+    const unsigned char *labels=(const unsigned char*)file->data()+mnistLabelsHeaderSize;
+    resLabels.assign(indices==nullptr?numofLabels:indices->size(),-0xFFFFFF);
+    for(auto &&it: mnist_samples(numofStored,numofLabels,indices)) resLabels[it.second]=labels[it.first];
   }
-  
 }
 
 //-----------------------------------------------------------------------------
-template <int N> void _load_mnist_images(const std::string &imagesFilename,
-                                  std::vector<LibImageSegmentation::ImageSegmentation<LibImageSegmentation::DefaultTypes::int_type,N> > &resImages,
-                                  std::vector<int> *indices)
+/** Load MNIST images.
+ *  @param resize A callable with arguments (std::size_t numofResults,int width,int height), which allocates the result.
+ *  @param store A callable with arguments (int position,const unsigned char *src,std::size_t numofPixels), which decodes
+ *               image _src_ into the result. It is called in parallel, the last image of a damaged file may be incomplete.
+ */
+template <class R,class S> void _load_mnist_images(const std::string &imagesFilename,std::vector<int> *indices,int numofThreads,R resize,S store)
 {
-  resImages.clear();
   if(imagesFilename.size()>0 && (indices==nullptr || indices->size()>0))
   {
-    std::ifstream in(imagesFilename,std::ifstream::binary);
-    int width,height;
-    int numofImages=-1;
-    char *buffer=new char[4];
-    int x,y,a,iid=0;
-    int index;
-    if(in.good()) 
+    std::size_t size;
+    std::unique_ptr<LibImageSegmentation::MappedFile> file=map_mnist_file(imagesFilename,"_load_mnist_images",size);
+    int numofImages=-1,width=0,height=0;
+    if(size>=mnistImagesHeaderSize)
     {
-      in.read(buffer,4);//magic number
-      in.read(buffer,4);//number of images
-      numofImages=(unsigned char)(buffer[3])+256*((unsigned char)(buffer[2]))+256*256*(unsigned char)(buffer[1])+256*256*256*(unsigned char)(buffer[0]);
-      
-      in.read(buffer,4);//height (number of rows)
-      height=(unsigned char)(buffer[3])+256*((unsigned char)(buffer[2]))+256*256*(unsigned char)(buffer[1])+256*256*256*(unsigned char)(buffer[0]);
-      in.read(buffer,4);//width (number of columns)
-      width=(unsigned char)(buffer[3])+256*((unsigned char)(buffer[2]))+256*256*(unsigned char)(buffer[1])+256*256*256*(unsigned char)(buffer[0]);
-      delete []buffer;
-      if(width>0 && height>0)
-      {
-        if(indices==nullptr) resImages.resize(numofImages);
-        else resImages.resize(indices->size());
-        buffer=new char[width*height];
-        while(in.good())
-        {
-          in.read(buffer,width*height);
-          if(in.gcount()>0)
-          {
-            if(indices!=nullptr) index=get_index_position(iid,indices);
-            if(indices==nullptr || index>=0)
-            {
-              if(indices==nullptr) index=iid;
-              a=0;
-              resImages[index].reallocate(width,height);
-              for(y=0;y<height;y++)
-              {
-                for(x=0;x<width;x++)
-                {
-                  resImages[index].data[x][y]=(unsigned char)(buffer[a]);
-                  a++;
-                }
-              }
-              if(in.gcount()!=width*height)
-              {
-                std::cerr << "Warning [_load_mnist_images]: " << imagesFilename << " is damaged, " << iid << "-th image is incomplete (" << in.gcount() << " bytes read, " << (width*height) << " expected)\n";
-                break;
-              }
-            }
-            iid++;
-          }
-        }
-        if(iid!=numofImages) std::cerr << "Warning [_load_mnist_images]: " << imagesFilename << ", number of images in the header and real number of images are different (" << numofImages<<"!=" << iid << ")\n";
-      }
-      else
-      {
-        throw(LibImageSegmentation::CoreException("Error [_load_mnist_images]: "+imagesFilename+", invalid width or height (width="+std::to_string(width)+", height"+std::to_string(height)+")."));
-      }
+      numofImages=read_mnist_int(file->data()+4);
+      height=read_mnist_int(file->data()+8);//number of rows
+      width=read_mnist_int(file->data()+12);//number of columns
     }
-    else
+    if(width<=0 || height<=0)
     {
-      throw(LibImageSegmentation::CoreException("Error [_load_mnist_images]: "+imagesFilename+" does not exist or is not readable."));
+      throw(LibImageSegmentation::CoreException("Error [_load_mnist_images]: "+imagesFilename+", invalid width or height (width="+std::to_string(width)+", height"+std::to_string(height)+")."));
     }
-    in.close();
-   
-    delete []buffer; 
+    std::size_t imageSize=(std::size_t)width*height,dataSize=size-mnistImagesHeaderSize;
+    int numofStored=(int)std::min(dataSize/imageSize,(std::size_t)std::numeric_limits<int>::max()-1);
+    if(dataSize%imageSize!=0)
+    {
+      std::cerr << "Warning [_load_mnist_images]: " << imagesFilename << " is damaged, " << numofStored << "-th image is incomplete (" << (dataSize%imageSize) << " bytes read, " << imageSize << " expected)\n";
+    }
+    if(numofStored!=numofImages) std::cerr << "Warning [_load_mnist_images]: " << imagesFilename << ", number of images in the header and real number of images are different (" << numofImages<<"!=" << numofStored << ")\n";
+    if(dataSize%imageSize!=0) numofStored++;
+    std::size_t numofResults=indices==nullptr?std::max(0,numofImages):indices->size();
+    resize(numofResults,width,height);
+    std::vector<std::pair<int,int> > samples=mnist_samples(numofStored,(int)numofResults,indices);
+    const unsigned char *pixels=(const unsigned char*)file->data()+mnistImagesHeaderSize;
+    int numofTasks=((int)samples.size()+mnistImagesPerTask-1)/mnistImagesPerTask;
+    LibImageSegmentation::parallel_for(numofTasks,numofThreads,[&](int task)
+    {
+      int last=std::min((int)samples.size(),(task+1)*mnistImagesPerTask);
+      for(int i=task*mnistImagesPerTask;i<last;i++)
+      {
+        std::size_t first=samples[i].first*imageSize;
+        store(samples[i].second,pixels+first,std::min(imageSize,dataSize-first));
+      }
+    });
   }
 }
-template void _load_mnist_images(const std::string &imagesFilename,
-                                 std::vector<LibImageSegmentation::ImageSegmentation<LibImageSegmentation::DefaultTypes::int_type,LibImageSegmentation::DefaultTypes::SegmentationN> > &resImages,
-                                 std::vector<int> *indices);
-template void _load_mnist_images(const std::string &imagesFilename,
-                                 std::vector<LibImageSegmentation::ImageSegmentation<LibImageSegmentation::DefaultTypes::int_type,LibImageSegmentation::DefaultTypes::SegmentationBlackWhiteN> > &resImages,
-                                 std::vector<int> *indices);
-template void _load_mnist_images(const std::string &imagesFilename,
-                                 std::vector<LibImageSegmentation::ImageSegmentation<LibImageSegmentation::DefaultTypes::int_type,1> > &resImages,
-                                 std::vector<int> *indices);
-
 //-----------------------------------------------------------------------------
-template <int N> void LibImageSegmentation::load_mnist(const std::string &imagesFilename,
-                                                    const std::string &labelsFilename,
-                                                    std::vector<ImageSegmentation<DefaultTypes::int_type,N> > &resImages,
-                                                    std::vector<int> &resLabels,
-                                                    int threshold,
-                                                    std::vector<int> *indices)
+/** Load MNIST images into separate segmentations/images.
+ *  @param table Values of the pixels for all 256 gray levels.
+ */
+template <class T,int N> void _load_mnist_images(const std::string &imagesFilename,
+                                  std::vector<LibImageSegmentation::ImageSegmentation<T,N> > &resImages,
+                                  std::vector<int> *indices,
+                                  const T *table,
+                                  int numofThreads)
+{
+  int width=0,height=0;
+  resImages.clear();
+  _load_mnist_images(imagesFilename,indices,numofThreads,[&](std::size_t numofResults,int w,int h)
+  {
+    resImages.resize(numofResults);
+    width=w;
+    height=h;
+  },
+  [&](int position,const unsigned char *src,std::size_t numofPixels)
+  {
+    auto &img=resImages[position];
+    img.reallocate(width,height);
+    for(int y=0;y<height;y++)
+      for(int x=0;x<width;x++)
+      {
+        std::size_t a=(std::size_t)y*width+x;
+        img.data[x][y]=a<numofPixels?table[src[a]]:T(0);
+      }
+  });
+}
+/** Load MNIST images into a dataset.
+ *  @param table Values of the pixels for all 256 gray levels.
+ */
+template <class T,int N> void _load_mnist_images(const std::string &imagesFilename,
+                                  LibImageSegmentation::Dataset<T,N> &resImages,
+                                  std::vector<int> *indices,
+                                  const T *table,
+                                  int numofThreads)
+{
+  resImages.release();
+  _load_mnist_images(imagesFilename,indices,numofThreads,[&](std::size_t numofResults,int width,int height)
+  {
+    resImages.reallocate(numofResults,width,height);
+  },
+  [&](int position,const unsigned char *src,std::size_t numofPixels)
+  {
+    T *dst=resImages.sample_buffer(position);
+    for(std::size_t a=0;a<numofPixels;a++) dst[a]=table[src[a]];
+  });
+}
+//-----------------------------------------------------------------------------
+template <int N,class T> void LibImageSegmentation::load_mnist(const std::string &imagesFilename,
+                                                            const std::string &labelsFilename,
+                                                            std::vector<ImageSegmentation<T,N> > &resImages,
+                                                            std::vector<int> &resLabels,
+                                                            int threshold,
+                                                            std::vector<int> *indices,
+                                                            int numofThreads)
 {
-  int x,y;
-  _load_mnist_images(imagesFilename,resImages,indices);
+  T table[256];
+  for(int i=0;i<256;i++) table[i]=i>=threshold;
+  _load_mnist_images(imagesFilename,resImages,indices,table,numofThreads);
   _load_mnist_labels(labelsFilename,resLabels,indices);
-  for(auto &&img: resImages)
-    for(x=0;x<img.width;x++)
-      for(y=0;y<img.height;y++)
-        img.data[x][y]=img.data[x][y]>=threshold;
 }
-template void LibImageSegmentation::load_mnist(const std::string &imagesFilename,
-                                            const std::string &labelsFilename,
-                                            std::vector<ImageSegmentation<DefaultTypes::int_type,DefaultTypes::SegmentationN> > &resImages,
-                                            std::vector<int> &resLabels,
-                                            int threshold,
-                                            std::vector<int> *indices);
-template void LibImageSegmentation::load_mnist(const std::string &imagesFilename,
-                                            const std::string &labelsFilename,
-                                            std::vector<ImageSegmentation<DefaultTypes::int_type,DefaultTypes::SegmentationBlackWhiteN> > &resImages,
-                                            std::vector<int> &resLabels,
-                                            int threshold,
-                                            std::vector<int> *indices);
+#define INST_LOAD_MNIST_SEGMENTATION(datatype,n) template void LibImageSegmentation::load_mnist(const std::string &imagesFilename,\
+                                                                                            const std::string &labelsFilename,\
+                                                                                            std::vector<ImageSegmentation<datatype,n> > &resImages,\
+                                                                                            std::vector<int> &resLabels,\
+                                                                                            int threshold,\
+                                                                                            std::vector<int> *indices,\
+                                                                                            int numofThreads)
+INST_LOAD_MNIST_SEGMENTATION(LibImageSegmentation::DefaultTypes::int_type,LibImageSegmentation::DefaultTypes::SegmentationN);
+INST_LOAD_MNIST_SEGMENTATION(LibImageSegmentation::DefaultTypes::int_type,LibImageSegmentation::DefaultTypes::SegmentationBlackWhiteN);
+INST_LOAD_MNIST_SEGMENTATION(uint8_t,LibImageSegmentation::DefaultTypes::SegmentationN);
+INST_LOAD_MNIST_SEGMENTATION(uint8_t,LibImageSegmentation::DefaultTypes::SegmentationBlackWhiteN);
+INST_LOAD_MNIST_SEGMENTATION(uint16_t,LibImageSegmentation::DefaultTypes::SegmentationN);
+INST_LOAD_MNIST_SEGMENTATION(uint16_t,LibImageSegmentation::DefaultTypes::SegmentationBlackWhiteN);
 //-----------------------------------------------------------------------------
-void LibImageSegmentation::load_mnist(const std::string &imagesFilename,
-                                   const std::string &labelsFilename,
-                                   std::vector<Image<DefaultTypes::int_type> > &resImages,
-                                   std::vector<int> &resLabels,
-                                   std::vector<int> *indices)
+template <class T> void LibImageSegmentation::load_mnist(const std::string &imagesFilename,
+                                                      const std::string &labelsFilename,
+                                                      std::vector<Image<T> > &resImages,
+                                                      std::vector<int> &resLabels,
+                                                      std::vector<int> *indices,
+                                                      int numofThreads)
 {
-  _load_mnist_images(imagesFilename,resImages,indices);
+  T table[256];
+  for(int i=0;i<256;i++) table[i]=i;
+  _load_mnist_images(imagesFilename,resImages,indices,table,numofThreads);
   _load_mnist_labels(labelsFilename,resLabels,indices);
 }
-
+#define INST_LOAD_MNIST_IMAGE(datatype) template void LibImageSegmentation::load_mnist(const std::string &imagesFilename,\
+                                                                                   const std::string &labelsFilename,\
+                                                                                   std::vector<Image<datatype> > &resImages,\
+                                                                                   std::vector<int> &resLabels,\
+                                                                                   std::vector<int> *indices,\
+                                                                                   int numofThreads)
+INST_LOAD_MNIST_IMAGE(LibImageSegmentation::DefaultTypes::int_type);
+INST_LOAD_MNIST_IMAGE(uint8_t);
+INST_LOAD_MNIST_IMAGE(uint16_t);
+//-----------------------------------------------------------------------------
+template <int N,class T> void LibImageSegmentation::load_mnist(const std::string &imagesFilename,
+                                                            const std::string &labelsFilename,
+                                                            Dataset<T,N> &resImages,
+                                                            std::vector<int> &resLabels,
+                                                            int threshold,
+                                                            std::vector<int> *indices,
+                                                            int numofThreads)
+{
+  T table[256];
+  for(int i=0;i<256;i++) table[i]=i>=threshold;
+  _load_mnist_images(imagesFilename,resImages,indices,table,numofThreads);
+  _load_mnist_labels(labelsFilename,resLabels,indices);
+}
+#define INST_LOAD_MNIST_SEGMENTATION_DATASET(datatype,n) template void LibImageSegmentation::load_mnist(const std::string &imagesFilename,\
+                                                                                                    const std::string &labelsFilename,\
+                                                                                                    Dataset<datatype,n> &resImages,\
+                                                                                                    std::vector<int> &resLabels,\
+                                                                                                    int threshold,\
+                                                                                                    std::vector<int> *indices,\
+                                                                                                    int numofThreads)
+INST_LOAD_MNIST_SEGMENTATION_DATASET(LibImageSegmentation::DefaultTypes::int_type,LibImageSegmentation::DefaultTypes::SegmentationN);
+INST_LOAD_MNIST_SEGMENTATION_DATASET(LibImageSegmentation::DefaultTypes::int_type,LibImageSegmentation::DefaultTypes::SegmentationBlackWhiteN);
+INST_LOAD_MNIST_SEGMENTATION_DATASET(uint8_t,LibImageSegmentation::DefaultTypes::SegmentationN);
+INST_LOAD_MNIST_SEGMENTATION_DATASET(uint8_t,LibImageSegmentation::DefaultTypes::SegmentationBlackWhiteN);
+INST_LOAD_MNIST_SEGMENTATION_DATASET(uint16_t,LibImageSegmentation::DefaultTypes::SegmentationN);
+INST_LOAD_MNIST_SEGMENTATION_DATASET(uint16_t,LibImageSegmentation::DefaultTypes::SegmentationBlackWhiteN);
+//-----------------------------------------------------------------------------
+template <class T> void LibImageSegmentation::load_mnist(const std::string &imagesFilename,
+                                                      const std::string &labelsFilename,
+                                                      Dataset<T,1> &resImages,
+                                                      std::vector<int> &resLabels,
+                                                      std::vector<int> *indices,
+                                                      int numofThreads)
+{
+  T table[256];
+  for(int i=0;i<256;i++) table[i]=i;
+  _load_mnist_images(imagesFilename,resImages,indices,table,numofThreads);
+  _load_mnist_labels(labelsFilename,resLabels,indices);
+}
+#define INST_LOAD_MNIST_IMAGE_DATASET(datatype) template void LibImageSegmentation::load_mnist(const std::string &imagesFilename,\
+                                                                                           const std::string &labelsFilename,\
+                                                                                           Dataset<datatype,1> &resImages,\
+                                                                                           std::vector<int> &resLabels,\
+                                                                                           std::vector<int> *indices,\
+                                                                                           int numofThreads)
+INST_LOAD_MNIST_IMAGE_DATASET(LibImageSegmentation::DefaultTypes::int_type);
+INST_LOAD_MNIST_IMAGE_DATASET(uint8_t);
+INST_LOAD_MNIST_IMAGE_DATASET(uint16_t);
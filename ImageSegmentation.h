@@ -5,13 +5,29 @@
 #include <sstream>
 #include <vector>
 #include <list>
+#include <locale>
+#include <memory>
+#include <algorithm>
 #include <array>
 #include <initializer_list>
 #include <exception>
 #include <string>
 #include <type_traits>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <functional>
 #include "Pixel.h"
 #include "Line.h"
+#include "Layout.h"
+#include "MappedFile.h"
+#include "Csv.h"
+#include "Fft.h"
+#include "Parallel.h"
+#if defined(__AVX__) || defined(__SSE2__)
+  #include <immintrin.h>
+#endif
 namespace LibImageSegmentation
 {
   ///Default underlying datatypes.
@@ -63,6 +79,10 @@ namespace LibImageSegmentation
   struct BadSegmentationFormatException : public Exception {BadSegmentationFormatException(int paletteSpectrum,int cimgSpectrum,const std::string &filename);};
   ///Bad combination of positions when stitching two images
   struct PositionException : public Exception {PositionException(const std::string &message) : Exception(message){}};
+  ///Operands of a pixel-wise operation have different dimensions
+  struct DimensionException : public Exception {DimensionException(const std::string &message) : Exception(message){}};
+  ///Bad format of a file in the native format
+  struct BadNativeFormatException : public Exception {BadNativeFormatException(const std::string &message) : Exception(message){}};
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
@@ -199,10 +219,27 @@ namespace LibImageSegmentation
       return(ret);
     }
     Color<T,N> get_color_for_segmentation(int index)const
+    {
+      return(this->data()[this->get_segmentation_color_index(index)]);
+    }
+    /** Position of the color of label index _index_ in the container, the colors except the first one (background)
+     *  are repeated cyclically.
+     *  @see get_color_for_segmentation
+     */
+    int get_segmentation_color_index(int index)const
     {
       if(index>0) index=((index-1) % (this->size()-1))+1;
       else index=0;
-      return(this->data()[index]);
+      return(index);
+    }
+    /** Palette index stored in segmentation label _l_.
+     *  Unsigned label types narrower than int cannot hold colorNotRecognized (-1), which is therefore stored
+     *  as the maximum value of the label type (e.g. 255 for uint8_t).
+     */
+    template <class L> static int get_label_index(const L &l)
+    {
+      if(std::is_unsigned<L>::value && sizeof(L)<sizeof(int) && l==std::numeric_limits<L>::max()) return(colorNotRecognized);
+      return((int)l);
     }
     ///Number of channels of colors in the container.
     const int spectrum=N;
@@ -211,9 +248,89 @@ namespace LibImageSegmentation
   struct StandardPalette : public Palette<int,3> {StandardPalette();};
   ///Bright segmentation palette for better visibility.
   struct BrightPalette : public Palette<int,3> {BrightPalette();};
+  /** Hash table of the colors of a palette, which finds the index of a color in O(1) instead of Palette::get_color_index's
+   *  linear search. The channels of a color are packed into one 64-bit key. Palettes whose colors cannot be packed
+   *  (floating point or negative channels, too many channels or too large values) are searched linearly.
+   *  The table is a snapshot, it has to be rebuilt when the palette changes.
+   */
+  template <class T,std::size_t N> class PaletteLookup
+  {
+    static_assert(N>0,"Error [PaletteLookup]: The palette must have at least one channel.");
+    ///Number of bits of one channel in the key.
+    static const int channelBits=64/N<32?64/N:32;
+    const Palette<T,N> &palette;
+    bool packed=true;
+    uint64_t mask=0;
+    std::vector<uint64_t> keys;
+    std::vector<int> indices;
+    ///Packs color _c_ into _key_, returns false if a channel is out of the packable range.
+    template <class U> static bool pack(const U &c,uint64_t &key)
+    {
+      key=0;
+      for(std::size_t i=0;i<N;i++)
+      {
+        if(channelBits==0 || c[i]<0 || (uint64_t)c[i]>=((uint64_t)1<<channelBits)) return(false);
+        key=(key<<channelBits)|(uint64_t)c[i];
+      }
+      return(true);
+    }
+    static std::size_t hash(uint64_t key){return((std::size_t)((key*0x9E3779B97F4A7C15ull)>>32));}
+    public:
+    ///Build the table of _palette_, which must exist as long as the table is used.
+    explicit PaletteLookup(const Palette<T,N> &palette) : palette(palette)
+    {
+      std::size_t capacity=16;
+      while(capacity<2*palette.size()) capacity*=2;
+      this->mask=capacity-1;
+      this->keys.assign(capacity,0);
+      this->indices.assign(capacity,(int)Palette<T,N>::colorNotRecognized);
+      this->packed=std::is_integral<T>::value;
+      for(std::size_t i=0;i<palette.size() && this->packed;i++)
+      {
+        uint64_t key;
+        if(!pack(palette[i],key)) {this->packed=false;break;}
+        std::size_t slot=hash(key)&this->mask;
+        while(this->indices[slot]!=Palette<T,N>::colorNotRecognized && this->keys[slot]!=key) slot=(slot+1)&this->mask;
+        if(this->indices[slot]==Palette<T,N>::colorNotRecognized)//The first occurrence of a color wins
+        {
+          this->keys[slot]=key;
+          this->indices[slot]=i;
+        }
+      }
+    }
+    /** Index of color _c_ (indexable by 0...N-1) in the palette.
+     *  @return The same value as Palette::get_color_index, i.e. Palette::colorNotRecognized if _c_ is not in the palette.
+     */
+    template <class U> int get_color_index(const U &c)const
+    {
+      if(this->packed)
+      {
+        uint64_t key;
+        if(!pack(c,key)) return(Palette<T,N>::colorNotRecognized);
+        std::size_t slot=hash(key)&this->mask;
+        while(this->indices[slot]!=Palette<T,N>::colorNotRecognized)
+        {
+          if(this->keys[slot]==key) return(this->indices[slot]);
+          slot=(slot+1)&this->mask;
+        }
+        return(Palette<T,N>::colorNotRecognized);
+      }
+      for(std::size_t i=0;i<this->palette.size();i++)
+      {
+        std::size_t ch=0;
+        while(ch<N && this->palette[i][ch]==c[ch]) ch++;
+        if(ch==N) return(i);
+      }
+      return(Palette<T,N>::colorNotRecognized);
+    }
+  };
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
+  template <class T,int N,class Layout=ColumnMajor> class ImageSegmentation;
+  template <class T,int N,class Layout> class ImageView;
+  template <class T,int N> class Dataset;
+  class PackedSegmentationBW;
   template <class T> class __PrivateCImgWrapper
   {
     void *cimg;
@@ -221,6 +338,8 @@ namespace LibImageSegmentation
     int height=-1;
     int spectrum=-1;
     __PrivateCImgWrapper(const std::string &filename);
+    ///Load every _step_-th pixel of rectangle \[_x1_,_y1_\]-\[_x2_,_y2_\] (clipped to the image) from _filename_, see ScanlineDecoder::read_region.
+    __PrivateCImgWrapper(const std::string &filename,int x1,int y1,int x2,int y2,int step);
     __PrivateCImgWrapper(int width,int height,int spectrum);
     __PrivateCImgWrapper(int spectrum,const std::string &text,T *foregroundColor,T *backgroundColor,int size);
     void init_dimensions(int width,int height,int spectrum){this->width=width;this->height=height;this->spectrum=spectrum;}
@@ -229,13 +348,20 @@ namespace LibImageSegmentation
     void get(int x,int y,std::vector<T> &res)const{res.resize(this->spectrum);for(int c=0;c<this->spectrum;c++) res[c]=this->_get(x,y,c);}
     template <std::size_t N> void get(int x,int y,Color<T,N> &res)const{for(size_t c=0;c<N;c++) res[c]=this->_get(x,y,c);}
     double get_average(int x,int y)const;
+    ///First pixel of channel _c_ (the channel is stored row by row, pixel \[x,y\] is at y*width+x), nullptr if _c_>=spectrum.
+    const T* plane(int c)const;
+    T* plane(int c);
     void set(int x,int y,int c,T value);
     void set(int x,int y,T value){this->set(x,y,0,value);}
     template <std::size_t N> void set(int x,int y,const Color<T,N> &color){for(size_t c=0;c<N;c++) this->set(x,y,c,color[c]);}
     void resize(double m,int cimgInterpolationType=1);
     void save(const std::string &filename)const;
     ~__PrivateCImgWrapper();
-    template<class TT,int N> friend class ImageSegmentation;
+    template<class TT,int N,class Layout> friend class ImageSegmentation;
+    template<class TT,int N,class Layout> friend class ImageView;
+    friend class PackedSegmentationBW;
+    friend class ScanlineCImgDecoder;
+    friend class ScanlineCImgEncoder;
   };
   
   //Enums
@@ -252,14 +378,466 @@ namespace LibImageSegmentation
   #endif
   ///Positions for stitching.
   enum class Position{Left,Right,Top,Bottom,Center};  
+  /** Algorithms of conv2.
+   *  Auto chooses Separable for separable filters (rank 1), FFT for other filters with at least fftConv2MinFilterPixels pixels
+   *  and Direct otherwise. Separable falls back to Direct for filters which are not separable.
+   */
+  enum class Conv2Method{Auto,Direct,Separable,FFT};
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+  /** Pixel types derived from the template parameters of ImageSegmentation and ImageView.
+   */
+  template <class T,int N> struct __ImageTypes
+  {
+    using color_type=typename std::conditional<N<=1, T, Color<T,N> >::type;
+    using cimg_underlying_type=typename std::conditional<std::is_same<T,uint8_t>::value,uint8_t, 
+                                typename std::conditional<std::is_same<T,uint16_t>::value,uint16_t,
+                                typename std::conditional<std::is_same<T,uint32_t>::value,uint32_t,
+                                typename std::conditional<std::is_same<T,uint64_t>::value,uint64_t,    
+                                typename std::conditional<std::is_floating_point<T>::value,DefaultTypes::float_type,
+                                typename std::conditional<std::is_unsigned<T>::value,DefaultTypes::uint_type,DefaultTypes::int_type
+                                >::type>::type>::type>::type>::type>::type;
+    using cimg_color_type=typename std::conditional<N<=1, cimg_underlying_type, Color<cimg_underlying_type,N> >::type;
+    ///Type used to write a pixel into a text stream, 8-bit labels are written as numbers instead of characters.
+    using print_type=typename std::conditional<N<=1 && std::is_integral<T>::value && sizeof(T)==1, int, color_type>::type;
+  };
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+  /** Non-owning read-only view of a rectangular part of a segmentation/image.
+   *  The view consists only of a pointer to its first pixel, the stride of the viewed image, its offset and its extent,
+   *  so it can be created from an ImageSegmentation or from another view at zero cost. The viewed image must 
+   *  outlive the view and must not be reallocated while the view is used.
+   * @tparam T Underlying type.
+   * @tparam N Number of channels.
+   * @tparam Layout Memory layout of the viewed image.
+   */
+  template <class T,int N,class Layout=ColumnMajor> class ImageView
+  {
+    public:
+    ///@see ImageSegmentation::color_type
+    using color_type=typename __ImageTypes<T,N>::color_type;
+    ///Memory layout of the pixels.
+    using layout_type=Layout;
+    ///Width (number of columns) of the view.
+    int width=0;
+    ///Height (number of rows) of the view.
+    int height=0;
+    ///X coordinate of the left-top corner of the view in the viewed image.
+    int offsetX=0;
+    ///Y coordinate of the left-top corner of the view in the viewed image.
+    int offsetY=0;
+    ///Stride of the viewed image.
+    int stride=0;
+    ///Pointer to the left-top pixel of the view.
+    const color_type *buffer=nullptr;
+    ///Pixel data, pixel \[x,y\] of the view is accessed as data\[x\]\[y\].
+    typename Layout::template view_accessor_type<const color_type> data{};
+    ///Dimensions \[width,height\].
+    Pixel<int> size()const{return(Pixel<int>(this->width,this->height));}
+    ///Number of channels.
+    const int spectrum=N<=1?1:N;
+    /** Constructor.
+     *  Creates an empty view.
+     */
+    ImageView(){}
+    /** Constructor.
+     *  Creates a view of the whole _img_.
+     */
+    ImageView(const ImageSegmentation<T,N,Layout> &img) : ImageView(img.buffer,img.stride,0,0,img.width,img.height){}
+    /** Constructor.
+     *  Creates a view of rectangle \[_x1_,_y1_\]-\[_x2_,_y2_\] of _img_. The parts of the rectangle
+     *  that lie outside _img_ are omitted.
+     */
+    ImageView(const ImageSegmentation<T,N,Layout> &img,int x1,int y1,int x2,int y2) : ImageView(ImageView<T,N,Layout>(img).view(x1,y1,x2,y2)){}
+    /** Constructor.
+     *  Creates a view of rectangle \[_z1.x_,_z1.y_\]-\[_z2.x_,_z2.y_\] of _img_. The parts of the rectangle
+     *  that lie outside _img_ are omitted.
+     */
+    ImageView(const ImageSegmentation<T,N,Layout> &img,const Pixel<int> &z1,const Pixel<int> &z2) : ImageView(img,z1.x,z1.y,z2.x,z2.y){}
+    ImageView(const ImageView<T,N,Layout> &v2) : ImageView(v2.buffer,v2.stride,v2.offsetX,v2.offsetY,v2.width,v2.height){}
+    ImageView<T,N,Layout>& operator=(const ImageView<T,N,Layout> &v2)
+    {
+      this->init(v2.buffer,v2.stride,v2.offsetX,v2.offsetY,v2.width,v2.height);
+      return(*this);
+    }
+    protected:
+    template <class TT,int NN> friend class Dataset;
+    ImageView(const color_type *buffer,int stride,int offsetX,int offsetY,int width,int height){this->init(buffer,stride,offsetX,offsetY,width,height);}
+    void init(const color_type *buffer,int stride,int offsetX,int offsetY,int width,int height)
+    {
+      this->buffer=buffer;
+      this->stride=stride;
+      this->offsetX=offsetX;
+      this->offsetY=offsetY;
+      this->width=width;
+      this->height=height;
+      this->data=typename Layout::template view_accessor_type<const color_type>(buffer,stride);
+    }
+    double bitdepth_2_norm(int bitdepth)const {if(bitdepth<0) {bitdepth+=9;}return((1<<bitdepth)-1);}
+    public:
+    //-------------------------------------------------------------------------
+    /** Create a view of rectangle \[_x1_,_y1_\]-\[_x2_,_y2_\] of this view.
+     *  The parts of the rectangle that lie outside this view are omitted. If the rectangle does not
+     *  intersect this view, the result is an empty view.
+     */
+    ImageView<T,N,Layout> view(int x1,int y1,int x2,int y2)const
+    {
+      int realX1=std::max(x1,0);
+      int realY1=std::max(y1,0);
+      int realX2=std::min(x2,this->width-1);
+      int realY2=std::min(y2,this->height-1);
+      if(realX1>realX2 || realY1>realY2) return(ImageView<T,N,Layout>());
+      return(ImageView<T,N,Layout>(this->buffer+Layout::offset(realX1,realY1,this->stride),this->stride,
+                                   this->offsetX+realX1,this->offsetY+realY1,realX2-realX1+1,realY2-realY1+1));
+    }
+    /** Create a view of rectangle \[_z1.x_,_z1.y_\]-\[_z2.x_,_z2.y_\] of this view.
+     *  @see view(int x1,int y1,int x2,int y2)const
+     */
+    ImageView<T,N,Layout> view(const Pixel<int> &z1,const Pixel<int> &z2)const{return(this->view(z1.x,z1.y,z2.x,z2.y));}
+    //-------------------------------------------------------------------------
+    /** Number of pixels (width*height).
+     */
+    std::size_t numof_pixels()const{return((std::size_t)this->width*this->height);}
+    /** Visit all pixels of the view in the order in which they are stored in memory.
+     *  @param f A callable with arguments (int x,int y).
+     */
+    template <class F> void traverse(F f)const {Layout::traverse(0,0,this->width-1,this->height-1,f);}
+    //-------------------------------------------------------------------------
+    /** Determines, whether pixel \[_x_,_y_\] is inside this view.
+     */
+    bool is_pixel_inside(int x,int y)const{return(x>=0 && x<this->width && y>=0 && y<this->height);}
+    /** Determines, whether pixel _z_ is inside this view.
+     */
+    bool is_pixel_inside(const Pixel<int> &z)const{return(this->is_pixel_inside(z.x,z.y));}
+    //-------------------------------------------------------------------------
+    /** Return value of pixel \[_x_,_y_\] of the view.
+     *  @see ImageSegmentation::get_pixel_safe(int x,int y)const
+     */
+    color_type get_pixel_safe(int x,int y)const
+    {
+      color_type ret{};
+      if(std::is_signed<T>::value) ret=color_type{-1};
+      if(this->is_pixel_inside(x,y)) ret=this->data[x][y];
+      return(ret);
+    }
+    /** Return value of pixel _z_ of the view.
+     *  @see ImageSegmentation::get_pixel_safe(int x,int y)const
+     */
+    template <class U> color_type get_pixel_safe(const Pixel<U> &z)const{return(this->get_pixel_safe(z.x,z.y));}
+    //-------------------------------------------------------------------------
+    /** Return number of occurences of _l_ in the view.
+     */
+    int count_label(const color_type &l)const
+    {
+      int ret=0,i;
+      int numofLines=Layout::rowMajor?this->height:this->width;
+      int lineLength=Layout::rowMajor?this->width:this->height;
+      for(i=0;i<numofLines;i++) 
+      {
+        const color_type *line=this->buffer+(std::size_t)i*this->stride;
+        ret+=(int)std::count(line,line+lineLength,l);
+      }
+      return(ret);
+    }
+    //-------------------------------------------------------------------------
+    /** Flood fill algorithm, which does not change the viewed image.
+     *  @param startX X coordinate of the starting point (in the coordinates of the view).
+     *  @param startY Y coordinate of the starting point (in the coordinates of the view).
+     *  @param boundingBoxZ1 Top-left corner of a rectangle that bounds pixels that might be flooded.
+     *  @param boundingBoxZ2 Bottom-right corner of a rectangle that bounds pixels that might be flooded.
+     *  @param equalsFunction A callable with two arguments of type const ImageView<T,N>::color_type &, 
+     *         that returns true if its parameters are considered equal and false otherwise.
+     *  @param resPixels std::vector of flooded pixels.
+     *  @param eightNeighborhood If true, the flooding considers 8-neigborhood of each pixel, false means 4-neigborhood.
+     */
+    template <class EqualsFunctionType> 
+    void flood_fill(int startX,int startY,
+                    Pixel<int> boundingBoxZ1,Pixel<int> boundingBoxZ2,
+                    EqualsFunctionType equalsFunction,
+                    std::vector<Pixel<int> > &resPixels,
+                    bool eightNeighborhood=false)const
+    {
+      resPixels.clear();
+      boundingBoxZ1.set(std::max(boundingBoxZ1.x,0),std::max(boundingBoxZ1.y,0));
+      boundingBoxZ2.set(std::min(boundingBoxZ2.x,this->width-1),std::min(boundingBoxZ2.y,this->height-1));
+      if(startX>=boundingBoxZ1.x && startX<=boundingBoxZ2.x && startY>=boundingBoxZ1.y && startY<=boundingBoxZ2.y)
+      {
+        const color_type &sourceLabel=this->data[startX][startY];
+        int boxWidth=boundingBoxZ2.x-boundingBoxZ1.x+1;
+        std::vector<char> visited((std::size_t)boxWidth*(boundingBoxZ2.y-boundingBoxZ1.y+1),0);
+        auto add_pixel=[&](int x,int y)
+        {
+          char &v=visited[(std::size_t)(y-boundingBoxZ1.y)*boxWidth+x-boundingBoxZ1.x];
+          if(!v && equalsFunction(this->data[x][y],sourceLabel)) {v=1;resPixels.emplace_back(x,y);}
+        };
+        add_pixel(startX,startY);
+        for(std::size_t i=0;i<resPixels.size();i++)
+        {
+          Pixel<int> p=resPixels[i];
+          if(p.x>boundingBoxZ1.x) add_pixel(p.x-1,p.y);
+          if(p.y>boundingBoxZ1.y) add_pixel(p.x,p.y-1);
+          if(p.x<boundingBoxZ2.x) add_pixel(p.x+1,p.y);
+          if(p.y<boundingBoxZ2.y) add_pixel(p.x,p.y+1);
+          if(eightNeighborhood)
+          {
+            if(p.x>boundingBoxZ1.x && p.y>boundingBoxZ1.y) add_pixel(p.x-1,p.y-1);
+            if(p.x>boundingBoxZ1.x && p.y<boundingBoxZ2.y) add_pixel(p.x-1,p.y+1);
+            if(p.x<boundingBoxZ2.x && p.y>boundingBoxZ1.y) add_pixel(p.x+1,p.y-1);
+            if(p.x<boundingBoxZ2.x && p.y<boundingBoxZ2.y) add_pixel(p.x+1,p.y+1);
+          }
+        }
+      }
+    }
+    /** Flood fill algorithm, which does not change the viewed image.
+     *  @see flood_fill(int startX,int startY,Pixel<int> boundingBoxZ1,Pixel<int> boundingBoxZ2,EqualsFunctionType equalsFunction,std::vector<Pixel<int> > &resPixels,bool eightNeighborhood)const
+     */
+    void flood_fill(int startX,int startY,
+                    const Pixel<int> &boundingBoxZ1,const Pixel<int> &boundingBoxZ2,
+                    std::vector<Pixel<int> > &resPixels,
+                    bool eightNeighborhood=false)const
+    {
+      auto equalsFunction=[](const color_type &c1,const color_type &c2){return(c1==c2);};
+      this->flood_fill(startX,startY,boundingBoxZ1,boundingBoxZ2,equalsFunction,resPixels,eightNeighborhood);
+    }
+    /** Flood fill algorithm, which does not change the viewed image.
+     *  @see flood_fill(int startX,int startY,Pixel<int> boundingBoxZ1,Pixel<int> boundingBoxZ2,EqualsFunctionType equalsFunction,std::vector<Pixel<int> > &resPixels,bool eightNeighborhood)const
+     */
+    void flood_fill(const Pixel<int> &startZ,
+                    const Pixel<int> &boundingBoxZ1,const Pixel<int> &boundingBoxZ2,
+                    std::vector<Pixel<int> > &resPixels,
+                    bool eightNeighborhood=false)const
+    {
+      this->flood_fill(startZ.x,startZ.y,boundingBoxZ1,boundingBoxZ2,resPixels,eightNeighborhood);
+    }
+    /** Flood fill algorithm, which does not change the viewed image. The whole view is the bounding box.
+     *  @see flood_fill(int startX,int startY,Pixel<int> boundingBoxZ1,Pixel<int> boundingBoxZ2,EqualsFunctionType equalsFunction,std::vector<Pixel<int> > &resPixels,bool eightNeighborhood)const
+     */
+    void flood_fill(const Pixel<int> &startZ,std::vector<Pixel<int> > &resPixels,bool eightNeighborhood=false)const
+    {
+      this->flood_fill(startZ.x,startZ.y,Pixel<int>(0,0),Pixel<int>(this->width-1,this->height-1),resPixels,eightNeighborhood);
+    }
+    //-------------------------------------------------------------------------
+    protected:
+    /** Write all pixels of the view into the channel planes of _cimg_, which has the same dimensions as the view.
+     *  _f_ is called as f(pixel,planes,i), where _planes_ are the first pixels of the channels of _cimg_
+     *  and _i_ is the position of the pixel in each plane.
+     *  @see ImageSegmentation::import_planes
+     */
+    template <class CT,class F> void export_planes(__PrivateCImgWrapper<CT> &cimg,F f)const
+    {
+      std::vector<CT*> planes(std::max(cimg.spectrum,1),nullptr);
+      for(int c=0;c<cimg.spectrum;c++) planes[c]=cimg.plane(c);
+      CT *const *p=planes.data();
+      if(Layout::rowMajor)
+      {
+        for(int y=0;y<this->height;y++)
+        {
+          const color_type *row=this->buffer+Layout::offset(0,y,this->stride);
+          std::size_t first=(std::size_t)y*this->width;
+          for(int x=0;x<this->width;x++) f(row[x],p,first+x);
+        }
+      }
+      else
+      {
+        const int block=64;
+        for(int y0=0;y0<this->height;y0+=block)
+        {
+          int y1=std::min(y0+block,this->height);
+          for(int x=0;x<this->width;x++)
+          {
+            const color_type *column=this->buffer+Layout::offset(x,0,this->stride);
+            for(int y=y0;y<y1;y++) f(column[y],p,(std::size_t)y*this->width+x);
+          }
+        }
+      }
+    }
+    //-------------------------------------------------------------------------
+    template <class U,int NN=N> void _save_raw(const typename std::enable_if<1<NN,std::string>::type &filename,double scale,double m)const
+    {
+      __PrivateCImgWrapper<U> cimg(this->width,this->height,this->spectrum);
+      this->export_planes(cimg,[&](const color_type &pixel,U *const *planes,std::size_t i)
+      {
+        for(int c=0;c<N;c++) planes[c][i]=(U)(m*pixel[c]);
+      });
+      cimg.resize(scale);
+      cimg.save(filename);
+    }
+    //-------------------------------------------------------------------------
+    template <class U,int NN=N> void _save_raw(const typename std::enable_if<!(1<NN),std::string>::type &filename,double scale,double m)const
+    {
+      __PrivateCImgWrapper<U> cimg(this->width,this->height,this->spectrum);
+      this->export_planes(cimg,[&](const color_type &pixel,U *const *planes,std::size_t i){planes[0][i]=(U)(m*pixel);});
+      cimg.resize(scale);
+      cimg.save(filename);
+    }
+    public:
+    //-------------------------------------------------------------------------
+    /** Save the view into a file as-is.
+     *  @see ImageSegmentation::save_raw
+     */
+    void save_raw(const std::string &filename,double scale=1,int desiredBitdepth=-1)const
+    {
+      double m=1;
+      if(std::is_floating_point<T>::value) m=this->bitdepth_2_norm(desiredBitdepth);
+      if(desiredBitdepth==8) this->_save_raw<uint8_t>(filename,scale,m);
+      else if(desiredBitdepth==16) this->_save_raw<uint16_t>(filename,scale,m);
+      else if(desiredBitdepth==32) this->_save_raw<uint32_t>(filename,scale,m);
+      else if(desiredBitdepth==64) this->_save_raw<uint64_t>(filename,scale,m);
+      else if(std::is_floating_point<T>::value) this->_save_raw<DefaultTypes::float_type>(filename,scale,m);
+      else if(std::is_unsigned<T>::value) this->_save_raw<DefaultTypes::uint_type>(filename,scale,m);
+      else this->_save_raw<DefaultTypes::int_type>(filename,scale,m);
+    }
+    //-------------------------------------------------------------------------
+    /** Save the view as a binary segmentation into a file.
+     *  @see ImageSegmentation::save_bw
+     */
+    template <class TT=T,int NN=N> 
+    void save_bw(const typename std::enable_if<std::is_arithmetic<TT>::value && (NN==DefaultTypes::SegmentationN || NN==DefaultTypes::SegmentationBlackWhiteN || NN==1),std::string>::type &filename)const
+    {
+      static_assert(NN==N,"Error [ImageView::save_bw]: Cannot change the number of channels.");
+      static_assert(std::is_same<TT,T>::value,"Error [ImageView::save_bw]: Cannot change the underlying type.");
+      this->save_bw(filename,1);
+    }
+    /** Save the view as a binary segmentation with custom foreground label into a file.
+     */    
+    void save_bw(const std::string &filename,const color_type &foregroundColor)const
+    {
+      __PrivateCImgWrapper<DefaultTypes::int_type> cimg(this->width,this->height,1);
+      this->export_planes(cimg,[&](const color_type &pixel,DefaultTypes::int_type *const *planes,std::size_t i)
+      {
+        planes[0][i]=255*(pixel==foregroundColor);
+      });
+      cimg.save(filename);
+    }
+    //-------------------------------------------------------------------------
+    /** Save the view as a segmentation into a file using the standard palette.
+     */
+    template <int NN=N> 
+    void save_segmentation(const typename std::enable_if<NN<=1,std::string>::type &filename)const
+    {
+      static_assert(NN==N,"Error [ImageView::save_segmentation]: Cannot change the number of channels.");
+      StandardPalette sp;
+      this->save_segmentation(filename,sp);
+    }
+    /** Save the view as a segmentation into a file using a custom palette.
+     *  The colors of the palette are converted once into a table, which is indexed by
+     *  Palette::get_segmentation_color_index of the labels.
+     */    
+    template <class PT,std::size_t PN,int NN=N> 
+    void save_segmentation(const typename std::enable_if<NN<=1,std::string>::type &filename,
+                           const Palette<PT,PN> &palette)const
+    {
+      __PrivateCImgWrapper<DefaultTypes::int_type> cimg(this->width,this->height,palette.spectrum);
+      std::vector<DefaultTypes::int_type> table(palette.size()*PN);
+      for(std::size_t i=0;i<palette.size();i++)
+        for(std::size_t c=0;c<PN;c++) table[i*PN+c]=palette[i][c];
+      this->export_planes(cimg,[&](const color_type &pixel,DefaultTypes::int_type *const *planes,std::size_t i)
+      {
+        const DefaultTypes::int_type *color=table.data()+(std::size_t)palette.get_segmentation_color_index(palette.get_label_index(pixel))*PN;
+        for(std::size_t c=0;c<PN;c++) planes[c][i]=color[c];
+      });
+      cimg.save(filename);
+    }
+    //-------------------------------------------------------------------------
+    /** Save the view of a segmentation into a file using the standard palette.
+     */
+    template <int NN=N> void save(const typename std::enable_if<NN==DefaultTypes::SegmentationN,std::string>::type &filename)const
+    {
+      static_assert(NN==N,"Error [ImageView::save]: Cannot change the number of channels.");
+      StandardPalette sp;
+      this->save_segmentation(filename,sp);
+    }
+    /** Save the view of a segmentation into a file using a custom palette.
+     */
+    template <class PT,std::size_t PN,int NN=N> 
+    void save(const typename std::enable_if<NN==DefaultTypes::SegmentationN,std::string>::type &filename,const Palette<PT,PN> &palette)const
+    {
+      static_assert(NN==N,"Error [ImageView::save]: Cannot change the number of channels.");
+      this->save_segmentation(filename,palette);
+    }
+    /** Save the view of a binary segmentation into a file.
+     */
+    template <int NN=N> void save(const typename std::enable_if<NN==DefaultTypes::SegmentationBlackWhiteN,std::string>::type &filename)const
+    {
+      static_assert(NN==N,"Error [ImageView::save]: Cannot change the number of channels.");
+      this->save_bw(filename,1);
+    }
+    /** Save the view of a single or multichannel image into a file.
+     */
+    template <int NN=N> 
+    void save(const typename std::enable_if<1<=NN && !(NN==DefaultTypes::SegmentationN || NN==DefaultTypes::SegmentationBlackWhiteN),std::string>::type &filename,
+              double scale=1,int desiredBitdepth=-1)const
+    {
+      static_assert(NN==N,"Error [ImageView::save]: Cannot change the number of channels.");
+      this->save_raw(filename,scale,desiredBitdepth);
+    }
+    //-------------------------------------------------------------------------
+    /** Save the view into a text csv file.
+     *  The rows are formatted in blocks into reused buffers, the blocks can be formatted by several threads
+     *  and they are written in order, so the file is the same for any number of threads.
+     *  @param numofThreads Number of threads, values <=0 mean the number of hardware threads.
+     */
+    void save_csv(const std::string &filename,char delimiter=',',int numofThreads=0)const    
+    {
+      std::ofstream of(filename);
+      if(of.is_open())
+      {
+        if(std::locale()!=std::locale::classic())//The stream formats the numbers according to the global locale
+        {
+          for(int y=0;y<this->height;y++)
+          {
+            for(int x=0;x<this->width;x++)
+            {
+              of << (typename __ImageTypes<T,N>::print_type)this->data[x][y];
+              if(x<this->width-1) of << delimiter;
+            }
+            of << "\n";
+          }
+        }
+        else
+        {
+          numofThreads=resolve_numof_threads(numofThreads);
+          const int rowsPerBlock=std::max(1,csvBlockItems/std::max(this->width,1));
+          const int numofBlocks=(this->height+rowsPerBlock-1)/rowsPerBlock;
+          std::vector<std::string> blocks(std::min(numofThreads,std::max(numofBlocks,1)));
+          for(int firstBlock=0;firstBlock<numofBlocks;firstBlock+=blocks.size())
+          {
+            int n=std::min((int)blocks.size(),numofBlocks-firstBlock);
+            parallel_for(n,numofThreads,[&](int i)
+            {
+              std::string &block=blocks[i];
+              block.clear();
+              int y1=std::min((firstBlock+i+1)*rowsPerBlock,this->height);
+              for(int y=(firstBlock+i)*rowsPerBlock;y<y1;y++)
+              {
+                for(int x=0;x<this->width;x++)
+                {
+                  append_csv_item(block,(typename __ImageTypes<T,N>::print_type)this->data[x][y]);
+                  if(x<this->width-1) block+=delimiter;
+                }
+                block+='\n';
+              }
+            });
+            for(int i=0;i<n;i++) of.write(blocks[i].data(),blocks[i].size());
+          }
+        }
+      }
+      of.close();
+    }
+    ///Approximate number of items in one block of rows formatted by save_csv.
+    static const int csvBlockItems=1<<16;
+  };
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
   /** Segmentation, single-channel or multichannel image.
    * @tparam T Underlying type.
    * @tparam N Number of channels.
+   * @tparam Layout Memory layout of the pixels, ColumnMajor (default) or RowMajor.
    */ 
-  template <class T,int N> class ImageSegmentation
+  template <class T,int N,class Layout> class ImageSegmentation
   {
     protected:
     enum class Message{Note,Warning,Error};
@@ -275,16 +853,14 @@ namespace LibImageSegmentation
     /** Data type representing color of one pixel. If template parameter N<=1 (single channel image or segmentation)
      *  color_type is directly the underlying image type T. For multichannel images the color_type is Color<T,N>
      */
-    using color_type=typename std::conditional<N<=1, T, Color<T,N> >::type;
+    using color_type=typename __ImageTypes<T,N>::color_type;
+    ///Read-only view of this segmentation/image.
+    using view_type=ImageView<T,N,Layout>;
     protected:
-    using cimg_underlying_type=typename std::conditional<std::is_same<T,uint8_t>::value,uint8_t, 
-                                typename std::conditional<std::is_same<T,uint16_t>::value,uint16_t,
-                                typename std::conditional<std::is_same<T,uint32_t>::value,uint32_t,
-                                typename std::conditional<std::is_same<T,uint64_t>::value,uint64_t,    
-                                typename std::conditional<std::is_floating_point<T>::value,DefaultTypes::float_type,
-                                typename std::conditional<std::is_unsigned<T>::value,DefaultTypes::uint_type,DefaultTypes::int_type
-                                >::type>::type>::type>::type>::type>::type;
-    using cimg_color_type=typename std::conditional<N<=1, cimg_underlying_type, Color<cimg_underlying_type,N> >::type;
+    using cimg_underlying_type=typename __ImageTypes<T,N>::cimg_underlying_type;
+    using cimg_color_type=typename __ImageTypes<T,N>::cimg_color_type;
+    ///Memory mapped file with the pixels, nullptr if the pixels are allocated on the heap.
+    MappedFile *mappedFile=nullptr;
     public:
 
     //Image data
@@ -298,8 +874,16 @@ namespace LibImageSegmentation
     Pixel<int> size(){return(Pixel<int>(this->width,this->height));}
     ///Number of channels.
     const int spectrum=N<=1?1:N;
-    ///Pixel data.
-    color_type** data=nullptr;
+    ///Memory layout of the pixels.
+    using layout_type=Layout;
+    /** Pixel data, pixel \[x,y\] is accessed as data\[x\]\[y\]. For the ColumnMajor layout data\[x\] 
+     *  points to the x-th column of buffer.
+     */
+    typename Layout::template accessor_type<color_type> data{};
+    ///Contiguous block of all pixels, the columns (ColumnMajor) or rows (RowMajor) are stored one after another.
+    color_type* buffer=nullptr;
+    ///Distance (number of elements) between the beginnings of two consecutive columns (ColumnMajor) or rows (RowMajor) in buffer.
+    int stride=0;
     /** Constructor.
      *  Creates an empty image/segmentation.
      */
@@ -347,12 +931,54 @@ namespace LibImageSegmentation
     /** Copy Constructor.
      *  Allocates a segmentation or image of size \[img2.width,img2.height\] and copies data from img2.
      */    
-    ImageSegmentation(const ImageSegmentation<T,N> &img2){this->verbose=img2.verbose;this->copy_data(img2);}
+    ImageSegmentation(const ImageSegmentation<T,N,Layout> &img2){this->verbose=img2.verbose;this->copy_data(img2);}
     /** Assignment operator.
      *  Reallocates a segmentation or image of size \[img2.width,img2.height\] and copies data from img2.
      */    
-    ImageSegmentation<T,N>& operator=(const ImageSegmentation<T,N> &img2){this->release();this->verbose=img2.verbose;this->copy_data(img2);return(*this);}
+    ImageSegmentation<T,N,Layout>& operator=(const ImageSegmentation<T,N,Layout> &img2){this->release();this->verbose=img2.verbose;this->copy_data(img2);return(*this);}
+    /** Move constructor.
+     *  Takes over the data of img2, which is left empty.
+     */
+    ImageSegmentation(ImageSegmentation<T,N,Layout> &&img2) noexcept : ImageSegmentation(img2.verbose) {this->swap_data(img2);}
+    /** Move assignment operator.
+     *  Releases the data of this segmentation or image and takes over the data of img2, which is left empty.
+     */
+    ImageSegmentation<T,N,Layout>& operator=(ImageSegmentation<T,N,Layout> &&img2) noexcept
+    {
+      if(this!=&img2)
+      {
+        this->release();
+        this->verbose=img2.verbose;
+        this->swap_data(img2);
+      }
+      return(*this);
+    }
     ~ImageSegmentation() {this->release();}
+    /** Exchange the data and the verbosity of this segmentation/image and _img2_.
+     *  No pixels are copied.
+     */
+    void swap(ImageSegmentation<T,N,Layout> &img2) noexcept
+    {
+      std::swap(this->verbose,img2.verbose);
+      this->swap_data(img2);
+    }
+    protected:
+    void swap_data(ImageSegmentation<T,N,Layout> &img2) noexcept
+    {
+      std::swap(this->width,img2.width);
+      std::swap(this->height,img2.height);
+      std::swap(this->stride,img2.stride);
+      std::swap(this->data,img2.data);
+      std::swap(this->buffer,img2.buffer);
+      std::swap(this->mappedFile,img2.mappedFile);
+    }
+    ///True if _view_ is a view of (a part of) this segmentation/image.
+    bool shares_pixels(const view_type &view)const
+    {
+      std::less<const color_type*> less;
+      return(this->buffer!=nullptr && view.buffer!=nullptr && !less(view.buffer,this->buffer) && less(view.buffer,this->buffer+this->numof_pixels()));
+    }
+    public:
     
     //-------------------------------------------------------------------------
     /** Reallocate the image to size \[size.x,size.y\].
@@ -360,11 +986,11 @@ namespace LibImageSegmentation
      */    
     void reallocate(const Pixel<int> &size){this->reallocate(size.x,size.y);}
     /** Reallocate the image to size \[width,height\].
-     *  The old data are destroyed and the content is lost.
+     *  The old data are destroyed and the content is lost. If the size changes, a memory mapped
+     *  image is unmapped (the file keeps the old data) and the new pixels are allocated on the heap.
      */
     void reallocate(int width,int height)
     {
-      int x,y;
       if(width!=this->width || height!=this->height)
       {
         this->release();
@@ -372,12 +998,9 @@ namespace LibImageSegmentation
         this->height=height;
         if(this->width>0 && this->height>0)
         {
-          this->data=new color_type*[this->width];
-          for(x=0;x<this->width;x++)
-          {
-            this->data[x]=new color_type[this->height];
-            for(y=0;y<this->height;y++) this->data[x][y]=color_type{}; 
-          }
+          this->stride=Layout::stride(this->width,this->height);
+          this->buffer=new color_type[(std::size_t)this->width*this->height]();
+          Layout::attach(this->data,this->buffer,this->width,this->height);
         }
       }
     }
@@ -386,16 +1009,225 @@ namespace LibImageSegmentation
      */
     void release()
     {
-      if(this->data!=nullptr)
+      Layout::detach(this->data);
+      if(this->mappedFile!=nullptr)
       {
-        for(int x=0;x<this->width;x++) delete []this->data[x];
-        delete []this->data;
+        delete this->mappedFile;
+        this->mappedFile=nullptr;
       }
+      else delete []this->buffer;
       this->width=0;
       this->height=0;
-      this->data=nullptr;
+      this->stride=0;
+      this->buffer=nullptr;
     }  
     //-------------------------------------------------------------------------
+    /** Save this segmentation/image into file _filename_ in the native format (see NativeHeader).
+     *  The buffer is written as it is, without any conversion of the pixels. Uncompressed files can be loaded
+     *  by load_native or memory mapped by map_file.
+     *  @param compression NativeCompression::RLE stores runs of identical pixels, which is efficient for segmentations.
+     */
+    void save_native(const std::string &filename,NativeCompression compression=NativeCompression::None)const
+    {
+      std::ofstream out(filename,std::ios::binary);
+      if(!out.is_open()) throw(CoreException(compose_message(Message::Error,"ImageSegmentation::save_native","Cannot create "+filename)));
+      NativeHeader header=NativeHeader::create<T,N,color_type>(this->width,this->height,Layout::rowMajor,0,0,compression);
+      out.write((const char*)&header,sizeof(header));
+      write_native_pixels(out,(const char*)this->buffer,this->numof_pixels(),sizeof(color_type),compression);
+      if(!out.good()) throw(CoreException(compose_message(Message::Error,"ImageSegmentation::save_native","Cannot write "+filename)));
+    }
+    /** Load segmentation/image saved by save_native from file _filename_.
+     *  The pixels are read directly into the buffer by a single read (uncompressed files with the same layout).
+     *  Files saved with the other memory layout are transposed while loading.
+     *  @throw BadNativeFormatException if the file does not contain an image of this type or if it is damaged.
+     */
+    void load_native(const std::string &filename)
+    {
+      std::ifstream in(filename,std::ios::binary);
+      if(!in.is_open()) throw(CoreException(compose_message(Message::Error,"ImageSegmentation::load_native","File not found: "+filename)));
+      NativeHeader header;
+      bool ok=read_native_header(in,header);
+      if(ok)
+      {
+        this->reallocate(header.width,header.height);
+        std::size_t pixelSize=sizeof(color_type);
+        if((header.rowMajor!=0)==Layout::rowMajor) ok=read_native_pixels(in,(char*)this->buffer,this->numof_pixels(),pixelSize,(NativeCompression)header.compression);
+        else
+        {
+          std::vector<char> pixels(this->numof_pixels()*pixelSize);
+          ok=read_native_pixels(in,pixels.data(),this->numof_pixels(),pixelSize,(NativeCompression)header.compression);
+          int fileStride=header.rowMajor?this->width:this->height;
+          this->traverse([&](int x,int y)
+          {
+            std::size_t i=header.rowMajor?RowMajor::offset(x,y,fileStride):ColumnMajor::offset(x,y,fileStride);
+            std::memcpy((void*)&this->data[x][y],pixels.data()+i*pixelSize,pixelSize);
+          });
+        }
+      }
+      if(!ok)
+      {
+        throw(BadNativeFormatException(compose_message(Message::Error,"ImageSegmentation::load_native",
+                                                       filename+" does not contain an image of this type or it is damaged.")));
+      }
+      if(this->verbose>=Verbose::Normal) std::cerr << compose_message(Message::Note,"ImageSegmentation::load_native","Image loaded correctly from "+filename) << "\n";
+    }
+    /** Load rectangle \[_z1_,_z2_\] of a segmentation/image saved by save_native, only every _step_-th row and column is loaded.
+     *  Only the rows (columns of column-major files) of the rectangle are read, compressed blocks which contain no pixel
+     *  of the rectangle are skipped without decoding.
+     *  @see load(const std::string &filename,const Pixel<int> &z1,const Pixel<int> &z2,int step,Args&&... args)
+     *  @throw BadNativeFormatException if the file does not contain an image of this type or if it is damaged.
+     */
+    void load_native(const std::string &filename,const Pixel<int> &z1,const Pixel<int> &z2,int step=1)
+    {
+      std::ifstream in(filename,std::ios::binary);
+      if(!in.is_open()) throw(CoreException(compose_message(Message::Error,"ImageSegmentation::load_native","File not found: "+filename)));
+      NativeHeader header;
+      bool ok=read_native_header(in,header);
+      if(ok)
+      {
+        step=std::max(step,1);
+        int x1=std::max(z1.x,0),y1=std::max(z1.y,0),x2=std::min(z2.x,(int)header.width-1),y2=std::min(z2.y,(int)header.height-1);
+        this->reallocate(x1<=x2?(x2-x1)/step+1:0,y1<=y2?(y2-y1)/step+1:0);
+        //Lines are the rows of row-major files and the columns of column-major files
+        bool rowMajor=header.rowMajor!=0;
+        int lineLength=rowMajor?header.width:header.height;
+        int line1=rowMajor?y1:x1,line2=rowMajor?y2:x2,pos1=rowMajor?x1:y1,pos2=rowMajor?x2:y2;
+        std::size_t pixelSize=sizeof(color_type),numofFilePixels=(std::size_t)header.width*header.height;
+        std::streamoff dataStart=in.tellg();
+        std::vector<char> block;
+        std::size_t blockFirst=0,blockPixels=0;
+        for(int line=line1;ok && this->numof_pixels()>0 && line<=line2;line+=step)
+        {
+          std::size_t lineStart=(std::size_t)line*lineLength;
+          int resLine=(line-line1)/step;
+          auto store=[&](int pos,const char *src)
+          {
+            int resPos=(pos-pos1)/step;
+            std::memcpy((void*)(rowMajor?&this->data[resPos][resLine]:&this->data[resLine][resPos]),src,pixelSize);
+          };
+          if(header.compression==(uint32_t)NativeCompression::None)
+          {
+            block.resize((std::size_t)(pos2-pos1+1)*pixelSize);
+            in.seekg(dataStart+(std::streamoff)((lineStart+pos1)*pixelSize));
+            ok=(bool)in.read(block.data(),block.size());
+            for(int pos=pos1;ok && pos<=pos2;pos+=step) store(pos,block.data()+(std::size_t)(pos-pos1)*pixelSize);
+          }
+          else
+          {
+            for(int pos=pos1;ok && pos<=pos2;pos+=step)
+            {
+              std::size_t i=lineStart+pos;
+              while(ok && i>=blockFirst+blockPixels)
+              {
+                blockFirst+=blockPixels;
+                blockPixels=std::min(nativeBlockPixels,numofFilePixels-blockFirst);
+                if(i>=blockFirst+blockPixels) ok=skip_native_pixels(in,blockPixels,pixelSize,NativeCompression::RLE);
+                else
+                {
+                  block.resize(blockPixels*pixelSize);
+                  ok=read_native_pixels(in,block.data(),blockPixels,pixelSize,NativeCompression::RLE);
+                }
+              }
+              if(ok) store(pos,block.data()+(i-blockFirst)*pixelSize);
+            }
+          }
+        }
+      }
+      if(!ok)
+      {
+        throw(BadNativeFormatException(compose_message(Message::Error,"ImageSegmentation::load_native",
+                                                       filename+" does not contain an image of this type or it is damaged.")));
+      }
+      if(this->verbose>=Verbose::Normal) std::cerr << compose_message(Message::Note,"ImageSegmentation::load_native","Image loaded correctly from "+filename) << "\n";
+    }
+    /** Map the pixels of this segmentation/image to file _filename_ in the native format.
+     *  Mapping is O(1), the pixels are loaded on demand, so the file may be larger than the memory.
+     *  All in-place operations (init_data, copy_data, flood_fill, draw_*, ...) work directly on the file,
+     *  the changes are written back by sync() and release(). Operations which change the size of the image
+     *  release the mapping and continue on the heap.
+     *  @throw BadNativeFormatException if _filename_ does not contain an image of this type and layout.
+     */
+    void map_file(const std::string &filename)
+    {
+      this->release();
+      MappedFile *file=new MappedFile(filename);
+      NativeHeader header,expected=NativeHeader::create<T,N,color_type>(0,0,Layout::rowMajor);
+      if(file->size()>=sizeof(header)) std::memcpy(&header,file->data(),sizeof(header));
+      if(file->size()<sizeof(header) || !header.is_compatible(expected) || header.width<0 || header.height<0 ||
+         file->size()<sizeof(header)+header.data_size())
+      {
+        delete file;
+        throw(BadNativeFormatException(compose_message(Message::Error,"ImageSegmentation::map_file",
+                                                       filename+" does not contain an image of this type and layout.")));
+      }
+      this->attach_mapped_file(file,header.width,header.height);
+    }
+    /** Create (or overwrite) file _filename_ with an image of size \[_width_,_height_\] in the native format
+     *  and map the pixels of this segmentation/image to it. All pixels are set to 0.
+     *  @see map_file(const std::string &filename)
+     */
+    void map_file(const std::string &filename,int width,int height)
+    {
+      this->release();
+      if(width<0) width=0;
+      if(height<0) height=0;
+      NativeHeader header=NativeHeader::create<T,N,color_type>(width,height,Layout::rowMajor);
+      MappedFile *file=new MappedFile(filename,sizeof(header)+header.data_size());
+      std::memcpy(file->data(),&header,sizeof(header));
+      this->attach_mapped_file(file,width,height);
+    }
+    /** Write the changes of a memory mapped segmentation/image back to its file.
+     *  @param wait If true, the method waits until the data are written, otherwise it only schedules the writing.
+     */
+    void sync(bool wait=true)const{if(this->mappedFile!=nullptr) this->mappedFile->sync(wait);}
+    /** Determines, whether the pixels are stored in a memory mapped file.
+     */
+    bool is_mapped()const{return(this->mappedFile!=nullptr);}
+    protected:
+    /** Read the header of a native file from _in_ and check, that the file contains an image of this type (any layout and compression).
+     *  Uncompressed files must contain all pixels described by the header, so a damaged header does not cause
+     *  an allocation of the image before the pixels are read.
+     */
+    static bool read_native_header(std::istream &in,NativeHeader &header)
+    {
+      in.read((char*)&header,sizeof(header));
+      if(in.gcount()!=sizeof(header) || header.width<0 || header.height<0 || header.compression>(uint32_t)NativeCompression::RLE ||
+         !header.is_compatible(NativeHeader::create<T,N,color_type>(0,0,header.rowMajor!=0,0,0,(NativeCompression)header.compression)))
+        return(false);
+      if((NativeCompression)header.compression==NativeCompression::None)
+      {
+        std::streampos pos=in.tellg();
+        in.seekg(0,std::ios::end);
+        std::streamoff remaining=in.tellg()-pos;
+        in.seekg(pos);
+        if(pos<0 || remaining<0 || (unsigned long long)remaining<header.data_size()) return(false);
+      }
+      return(true);
+    }
+    void attach_mapped_file(MappedFile *file,int width,int height)
+    {
+      this->mappedFile=file;
+      this->width=width;
+      this->height=height;
+      this->stride=Layout::stride(width,height);
+      this->buffer=reinterpret_cast<color_type*>(file->data()+sizeof(NativeHeader));
+      if(width>0 && height>0) Layout::attach(this->data,this->buffer,width,height);
+    }
+    public:
+    //-------------------------------------------------------------------------
+    /** Number of pixels (width*height).
+     */
+    std::size_t numof_pixels()const{return((std::size_t)this->width*this->height);}
+    //-------------------------------------------------------------------------
+    /** Visit all pixels of rectangle \[_x1_,_y1_\]-\[_x2_,_y2_\] in the order in which they are stored in memory.
+     *  @param f A callable with arguments (int x,int y).
+     */
+    template <class F> void traverse(int x1,int y1,int x2,int y2,F f)const {Layout::traverse(x1,y1,x2,y2,f);}
+    /** Visit all pixels in the order in which they are stored in memory.
+     *  @param f A callable with arguments (int x,int y).
+     */
+    template <class F> void traverse(F f)const {Layout::traverse(0,0,this->width-1,this->height-1,f);}
+    //-------------------------------------------------------------------------
     /** Init data in rectangle \[_z1.x_,_z1.y_\]-\[_z2.x_,_z2.y_\] to value _color_.
      */
     template <class U, class V> void init_data(const color_type &color,const Pixel<U> &z1,const Pixel<V> &z2)
@@ -414,9 +1246,14 @@ namespace LibImageSegmentation
       if(y1<0) y1=0;
       if(x2<0) x2=this->width-1;
       if(y2<0) y2=this->height-1;
-      for(x=x1;x<=x2;x++)
+      if(x2<x1 || y2<y1) return;
+      if(x1==0 && y1==0 && x2==this->width-1 && y2==this->height-1) std::fill(this->buffer,this->buffer+this->numof_pixels(),color);
+      else if(Layout::rowMajor)
         for(y=y1;y<=y2;y++)
-          this->data[x][y]=color;
+          std::fill(&this->data[x1][y],&this->data[x1][y]+(x2-x1+1),color);
+      else 
+        for(x=x1;x<=x2;x++)
+          std::fill(&this->data[x][y1],&this->data[x][y1]+(y2-y1+1),color);
     }
     //-------------------------------------------------------------------------
     /** Copy data of _img2_ to this image/segmentation.
@@ -424,23 +1261,65 @@ namespace LibImageSegmentation
      *  will be copied to \[_targetZ.x_,_targetZ.y_\] in this image/segmentation). If this image
      *  is not big enough for _img2_ data, it is reallocated and it's original content is lost.
      */    
-    void copy_data(const ImageSegmentation<T,N> &img2,const Pixel<int> &targetZ){this->copy_data(img2,targetZ.x,targetZ.y);}
+    void copy_data(const ImageSegmentation<T,N,Layout> &img2,const Pixel<int> &targetZ){this->copy_data(img2,targetZ.x,targetZ.y);}
     /** Copy data of _img2_ to this image/segmentation.
      *  The data are shifted by vector \[_targetX_,_targetY_\] (i.e. pixel \[0,0\] of _img2_
      *  will be copied to \[_targetX_,_targetY_\] in this image/segmentation). If this image
      *  is not big enough for _img2_ data, it is reallocated and it's original content is lost.
      */    
-    void copy_data(const ImageSegmentation<T,N> &img2,int targetX=0,int targetY=0)
+    void copy_data(const ImageSegmentation<T,N,Layout> &img2,int targetX=0,int targetY=0)
     {
       if(this->width<img2.width+targetX || this->height<img2.height+targetY) this->reallocate(img2.width,img2.height);
-      int x,y;
       int leftX=std::max(0,-targetX);
       int topY=std::max(0,-targetY);
-      for(x=leftX;x<img2.width;x++)
-        for(y=topY;y<img2.height;y++) 
-          this->data[x+targetX][y+targetY]=img2.data[x][y];
+      if(leftX>=img2.width || topY>=img2.height) return;
+      if(targetX==0 && targetY==0 && img2.width==this->width && img2.height==this->height)
+      {
+        std::copy(img2.buffer,img2.buffer+img2.numof_pixels(),this->buffer);
+      }
+      else copy_rectangle(img2,leftX,topY,img2.width-1,img2.height-1,*this,leftX+targetX,topY+targetY);
+    }
+    /** Copy data of view _v2_ to this image/segmentation.
+     *  @see copy_data(const ImageSegmentation<T,N,Layout> &img2,int targetX,int targetY)
+     */
+    void copy_data(const view_type &v2,int targetX=0,int targetY=0)
+    {
+      if(this->width<v2.width+targetX || this->height<v2.height+targetY) this->reallocate(v2.width,v2.height);
+      int leftX=std::max(0,-targetX);
+      int topY=std::max(0,-targetY);
+      if(leftX>=v2.width || topY>=v2.height) return;
+      copy_rectangle(v2,leftX,topY,v2.width-1,v2.height-1,*this,leftX+targetX,topY+targetY);
     }
     //-------------------------------------------------------------------------
+    /** Create a read-only view of the whole segmentation/image.
+     */
+    view_type view()const{return(view_type(*this));}
+    /** Create a read-only view of rectangle \[_x1_,_y1_\]-\[_x2_,_y2_\] without copying the pixels.
+     *  The parts of the rectangle that lie outside the segmentation/image are omitted.
+     *  @see cut(int x1,int y1,int x2,int y2,ImageSegmentation<T,N,Layout> &res)const
+     */
+    view_type view(int x1,int y1,int x2,int y2)const{return(view_type(*this,x1,y1,x2,y2));}
+    /** Create a read-only view of rectangle \[_z1.x_,_z1.y_\]-\[_z2.x_,_z2.y_\] without copying the pixels.
+     *  @see view(int x1,int y1,int x2,int y2)const
+     */
+    view_type view(const Pixel<int> &z1,const Pixel<int> &z2)const{return(view_type(*this,z1,z2));}
+    //-------------------------------------------------------------------------
+    protected:
+    /** Copy rectangle \[_x1_,_y1_\]-\[_x2_,_y2_\] of _src_ to _dst_ such that pixel \[_x1_,_y1_\] 
+     *  is copied to \[_targetX_,_targetY_\]. Both rectangles must lie inside the images.
+     */
+    static void copy_rectangle(const view_type &src,int x1,int y1,int x2,int y2,ImageSegmentation<T,N,Layout> &dst,int targetX,int targetY)
+    {
+      int x,y;
+      if(Layout::rowMajor)
+        for(y=y1;y<=y2;y++)
+          std::copy(&src.data[x1][y],&src.data[x1][y]+(x2-x1+1),&dst.data[targetX][targetY+y-y1]);
+      else
+        for(x=x1;x<=x2;x++)
+          std::copy(&src.data[x][y1],&src.data[x][y1]+(y2-y1+1),&dst.data[targetX+x-x1][targetY]);
+    }
+    public:
+    //-------------------------------------------------------------------------
     /** Determines, whether pixel _z_ is inside this image/segmentation.
      */
     bool is_pixel_inside(const Pixel<int> &z)const{return(this->is_pixel_inside(z.x,z.y));}
@@ -507,12 +1386,7 @@ namespace LibImageSegmentation
      */
     int count_label(const color_type &l)
     {
-      int ret=0;
-      int x,y;
-      for(x=0;x<this->width;x++)
-        for(y=0;y<this->height;y++)
-          ret+=this->data[x][y]==l;
-      return(ret);
+      return((int)std::count(this->buffer,this->buffer+this->numof_pixels(),l));
     }
     //-------------------------------------------------------------------------
     /** Resize segmentation/image.
@@ -521,24 +1395,19 @@ namespace LibImageSegmentation
     template <class TT=T> void resize(typename std::enable_if<std::is_arithmetic<TT>::value,double>::type scale,CImgInterpolation interpolationType=CImgInterpolation::Linear)
     {
       static_assert(std::is_same<TT,T>::value,"Error [ImageSegmentation::resize]: Cannot change the underlying type.");
-      int x,y;
+      if((int)(scale*this->width)==this->width && (int)(scale*this->height)==this->height) return;
       __PrivateCImgWrapper<cimg_underlying_type> cimg(this->width,this->height,this->spectrum);
 
-      for(x=0;x<this->width;x++)
-        for(y=0;y<this->height;y++)
-          cimg.set(x,y,this->data[x][y]);
+      this->traverse([&](int x,int y){cimg.set(x,y,this->data[x][y]);});
       cimg.resize(scale,(int)interpolationType);
       this->reallocate(cimg.width,cimg.height);
 
       cimg_color_type cc{};
-      for(x=0;x<this->width;x++)
+      this->traverse([&](int x,int y)
       {
-        for(y=0;y<this->height;y++)
-        {
-          cimg.get(x,y,cc);
-          this->data[x][y]=cc;
-        }
-      }
+        cimg.get(x,y,cc);
+        this->data[x][y]=cc;
+      });
     }
     //-------------------------------------------------------------------------
     /** Cut a rectangle from this image.
@@ -549,7 +1418,7 @@ namespace LibImageSegmentation
      *         lie completely inside the segmentation/image, the outside pixels are omited and the size
      *         of the cut is changed accordingly.
      */     
-    void cut(const Pixel<int> &z1, const Pixel<int> &z2, ImageSegmentation<T,N> &res)const {this->cut(z1.x,z1.y,z2.x,z2.y,res);}
+    void cut(const Pixel<int> &z1, const Pixel<int> &z2, ImageSegmentation<T,N,Layout> &res)const {this->cut(z1.x,z1.y,z2.x,z2.y,res);}
     //-------------------------------------------------------------------------
     /** Cut a rectangle from this image.
      *  @param x1 X coordinate of the left-top corner of the cut rectangle.
@@ -561,7 +1430,7 @@ namespace LibImageSegmentation
      *         lie completely inside the segmentation/image, the outside pixels are omited and the size
      *         of the cut is changed accordingly.
      */
-    void cut(int x1,int y1,int x2,int y2,ImageSegmentation<T,N> &res)const
+    void cut(int x1,int y1,int x2,int y2,ImageSegmentation<T,N,Layout> &res)const
     {
       int resRealX1=0,resRealY1=0,resRealX2=0,resRealY2=0;
       this->cut(x1,y1,x2,y2,res,resRealX1,resRealY1,resRealX2,resRealY2);
@@ -579,7 +1448,7 @@ namespace LibImageSegmentation
      *  @param resRealX2 X coordinate of the resulting cut rectangle that corresponds to x=res.width-1.
      *  @param resRealY2 Y coordinate of the resulting cut rectangle that corresponds to y=res.height-1.
      */    
-    void cut(const Pixel<int> &z1,const Pixel<int> &z2,ImageSegmentation<T,N> &res,Pixel<int> &resRealZ1,Pixel<int> &resRealZ2)const
+    void cut(const Pixel<int> &z1,const Pixel<int> &z2,ImageSegmentation<T,N,Layout> &res,Pixel<int> &resRealZ1,Pixel<int> &resRealZ2)const
     {
       this->cut(z1.x,z1.y,z2.x,z2.y,res,resRealZ1.x,resRealZ1.y,resRealZ2.x,resRealZ2.y);
     }
@@ -598,19 +1467,16 @@ namespace LibImageSegmentation
      *  @param resRealX2 X coordinate of the resulting cut rectangle that corresponds to x=res.width-1.
      *  @param resRealY2 Y coordinate of the resulting cut rectangle that corresponds to y=res.height-1.
      */
-    void cut(int x1,int y1,int x2,int y2,ImageSegmentation<T,N> &res,int &resRealX1,int &resRealY1,int &resRealX2,int &resRealY2)const
+    void cut(int x1,int y1,int x2,int y2,ImageSegmentation<T,N,Layout> &res,int &resRealX1,int &resRealY1,int &resRealX2,int &resRealY2)const
     {
       int realX1=std::max(x1,0);
       int realY1=std::max(y1,0);
       int realX2=std::min(x2,this->width-1);
       int realY2=std::min(y2,this->height-1);
-      int x,y;
       if(realX1<=realX2 && realY1<=realY2)
       {
         res.reallocate(realX2-realX1+1,realY2-realY1+1);
-        for(x=realX1;x<=realX2;x++)
-          for(y=realY1;y<=realY2;y++)
-            res.data[x-realX1][y-realY1]=this->data[x][y];
+        copy_rectangle(*this,realX1,realY1,realX2,realY2,res,0,0);
       }
       resRealX1=realX1;
       resRealY1=realY1;
@@ -631,7 +1497,7 @@ namespace LibImageSegmentation
      *  @param dividingLineThickness Thickness of the dividing line in pixels.
      *  @param dividingLineColor Color of the dividing line.
      */
-    void stitch(const ImageSegmentation<T,N> &img2,Position primaryAlignment,Position secondaryAlignment,const color_type &backgroundColor=color_type{},int dividingLineThickness=0,const color_type &dividingLineColor=color_type{})
+    void stitch(const ImageSegmentation<T,N,Layout> &img2,Position primaryAlignment,Position secondaryAlignment,const color_type &backgroundColor=color_type{},int dividingLineThickness=0,const color_type &dividingLineColor=color_type{})
     {
       int originalX=0,originalY=0;
       int appendedX=0,appendedY=0;
@@ -680,13 +1546,13 @@ namespace LibImageSegmentation
         throw(PositionException(compose_message(Message::Error,"ImageSegmentation::stitch","Cannot append image at position "+std::to_string((int)primaryAlignment)+".")));
       }
       //Reallocate and draw
-      ImageSegmentation<T,N> backup(*this);
-      ImageSegmentation<T,N> backup2(img2);//In case *this==img2
+      ImageSegmentation<T,N,Layout> backup(std::move(*this));
+      const ImageSegmentation<T,N,Layout> &appended=(&img2==this)?backup:img2;
       this->reallocate(newWidth,newHeight);
       this->init_data(backgroundColor);
       this->init_data(dividingLineColor,dx1,dy1,dx2,dy2);
       this->copy_data(backup,originalX,originalY);
-      this->copy_data(backup2,appendedX,appendedY);
+      this->copy_data(appended,appendedX,appendedY);
     }
     //-------------------------------------------------------------------------
     /** Draw line.
@@ -830,7 +1696,6 @@ namespace LibImageSegmentation
      */
     void draw_text(int offsetX,int offsetY,const std::string &text,int size,const color_type &foregroundColor,const color_type &backgroundColor)
     {
-      int x,y;
       cimg_underlying_type bgc[N<=1?1:N];
       cimg_underlying_type fgc[N<=1?1:N];
       this->fill_color_for_draw_text(backgroundColor,0,bgc);
@@ -846,33 +1711,36 @@ namespace LibImageSegmentation
       }
       cimg_color_type cc{};
       color_type color{};
-      for(x=0;x<cimg.width;x++)
+      this->traverse(0,0,cimg.width-1,cimg.height-1,[&](int x,int y)
       {
-        for(y=0;y<cimg.height;y++)
+        cimg.get(x,y,cc);
+        if(std::is_arithmetic<T>::value) color=cc;
+        else
         {
-          cimg.get(x,y,cc);
-          if(std::is_arithmetic<T>::value) color=cc;
-          else
-          {
-            double average=cimg.get_average(x,y);
-            color=average>127?foregroundColor:backgroundColor;
-          }
-          this->set_pixel_safe(x+offsetX,y+offsetY,color);
+          double average=cimg.get_average(x,y);
+          color=average>127?foregroundColor:backgroundColor;
         }
-      }
+        this->set_pixel_safe(x+offsetX,y+offsetY,color);
+      });
       
     }
     //-------------------------------------------------------------------------
     /** Implements Matlab function conv2(this,filter,'same').
+     *  Filters of rank 1 (Gaussian, box, Sobel, ...) are detected and convolved by two 1D passes, i.e. in
+     *  O(filter.width+filter.height) instead of O(filter.width*filter.height) operations per pixel. Other filters with
+     *  at least fftConv2MinFilterPixels pixels are convolved by FFT (see FftConvolution).
      *  This method is defined only if the underlying type T of the segmentation/image is arithmetic.
      *  @param filter Convolution filter.
      *  @param boundariesNormalizeBrightness If true, pixels near image boundary are convolved using only 
      *         a "valid" part of the filter, which overlaps with the image. False is equivalent to zero-padding.
+     *  @param method Algorithm of the convolution, the results of the algorithms differ only by rounding errors.
+     *  @param numofThreads Number of threads, values <=0 mean the number of hardware threads.
      */
-    template <class TT=T> void conv2(const typename std::enable_if<std::is_arithmetic<TT>::value,ImageSegmentation<T,N> >::type &filter,bool boundariesNormalizeBrightness=true)
+    template <class TT=T> void conv2(const typename std::enable_if<std::is_arithmetic<TT>::value,ImageSegmentation<T,N,Layout> >::type &filter,bool boundariesNormalizeBrightness=true,
+                                     Conv2Method method=Conv2Method::Auto,int numofThreads=0)
     {
       static_assert(std::is_same<TT,T>::value,"Error [ImageSegmentation::conv2]: Cannot change the underlying type.");
-      this->conv2(filter,filter.width/2,filter.height/2,boundariesNormalizeBrightness);
+      this->conv2(filter,filter.width/2,filter.height/2,boundariesNormalizeBrightness,method,numofThreads);
     }
     /** Implements Matlab function conv2(this,filter,'same').
      *  This method is defined only if the underlying type T of the segmentation/image is arithmetic.
@@ -880,11 +1748,14 @@ namespace LibImageSegmentation
      *  @param filterCenterZ Coordinates of the center pixel of the filter. 
      *  @param boundariesNormalizeBrightness If true, pixels near image boundary are convolved using only 
      *         a "valid" part of the filter, which overlaps with the image. False is equivalent to zero-padding.
+     *  @param method Algorithm of the convolution, the results of the algorithms differ only by rounding errors.
+     *  @param numofThreads Number of threads, values <=0 mean the number of hardware threads.
      */    
-    template <class TT=T> void conv2(const typename std::enable_if<std::is_arithmetic<TT>::value,ImageSegmentation<T,N> >::type &filter,const Pixel<int> &filterCenterZ,bool boundariesNormalizeBrightness=true)
+    template <class TT=T> void conv2(const typename std::enable_if<std::is_arithmetic<TT>::value,ImageSegmentation<T,N,Layout> >::type &filter,const Pixel<int> &filterCenterZ,bool boundariesNormalizeBrightness=true,
+                                     Conv2Method method=Conv2Method::Auto,int numofThreads=0)
     {
       static_assert(std::is_same<TT,T>::value,"Error [ImageSegmentation::conv2]: Cannot change the underlying type.");
-      this->conv2(filter,filterCenterZ.x,filterCenterZ.y,boundariesNormalizeBrightness);
+      this->conv2(filter,filterCenterZ.x,filterCenterZ.y,boundariesNormalizeBrightness,method,numofThreads);
     }
     /** Implements Matlab function conv2(this,filter,'same').
      *  This method is defined only if the underlying type T of the segmentation/image is arithmetic.
@@ -893,50 +1764,523 @@ namespace LibImageSegmentation
      *  @param filterCenterY Y coordinate of the center pixel of the filter.  
      *  @param boundariesNormalizeBrightness If true, pixels near image boundary are convolved using only 
      *         a "valid" part of the filter, which overlaps with the image. False is equivalent to zero-padding.
+     *  @param method Algorithm of the convolution, the results of the algorithms differ only by rounding errors.
+     *  @param numofThreads Number of threads, values <=0 mean the number of hardware threads.
      */    
-    template <class TT=T> void conv2(const typename std::enable_if<std::is_arithmetic<TT>::value,ImageSegmentation<T,N> >::type &filter,int filterCenterX, int filterCenterY,bool boundariesNormalizeBrightness=true)
+    template <class TT=T> void conv2(const typename std::enable_if<std::is_arithmetic<TT>::value,ImageSegmentation<T,N,Layout> >::type &filter,int filterCenterX, int filterCenterY,bool boundariesNormalizeBrightness=true,
+                                     Conv2Method method=Conv2Method::Auto,int numofThreads=0)
+    {
+      static_assert(std::is_same<TT,T>::value,"Error [ImageSegmentation::conv2]: Cannot change the underlying type.");
+      ImageSegmentation<T,N,Layout> tmp(this->verbose);
+      conv2_kernel(this->view(),filter,filterCenterX,filterCenterY,boundariesNormalizeBrightness,method,numofThreads,tmp);
+      this->swap_data(tmp);
+    }
+    //-------------------------------------------------------------------------
+    /** Implements Matlab function conv2(source,filter,'same') and stores the result into this image.
+     *  This image is reallocated to the size of _source_, which may be a view of this image.
+     *  The algorithm is chosen by the size and the rank of the filter, see conv2(const ImageSegmentation<T,N,Layout>&,bool,Conv2Method,int).
+     *  This method is defined only if the underlying type T of the segmentation/image is arithmetic.
+     *  @param source Convolved image or its part.
+     *  @param filter Convolution filter.
+     *  @param boundariesNormalizeBrightness If true, pixels near image boundary are convolved using only 
+     *         a "valid" part of the filter, which overlaps with the image. False is equivalent to zero-padding.
+     *  @param method Algorithm of the convolution, the results of the algorithms differ only by rounding errors.
+     *  @param numofThreads Number of threads, values <=0 mean the number of hardware threads.
+     */
+    template <class TT=T> void conv2(const typename std::enable_if<std::is_arithmetic<TT>::value,view_type>::type &source,const ImageSegmentation<T,N,Layout> &filter,bool boundariesNormalizeBrightness=true,
+                                     Conv2Method method=Conv2Method::Auto,int numofThreads=0)
+    {
+      static_assert(std::is_same<TT,T>::value,"Error [ImageSegmentation::conv2]: Cannot change the underlying type.");
+      this->conv2(source,filter,filter.width/2,filter.height/2,boundariesNormalizeBrightness,method,numofThreads);
+    }
+    /** Implements Matlab function conv2(source,filter,'same') and stores the result into this image.
+     *  @see conv2(const view_type &source,const ImageSegmentation<T,N,Layout> &filter,int filterCenterX,int filterCenterY,bool boundariesNormalizeBrightness,Conv2Method method,int numofThreads)
+     */
+    template <class TT=T> void conv2(const typename std::enable_if<std::is_arithmetic<TT>::value,view_type>::type &source,const ImageSegmentation<T,N,Layout> &filter,const Pixel<int> &filterCenterZ,bool boundariesNormalizeBrightness=true,
+                                     Conv2Method method=Conv2Method::Auto,int numofThreads=0)
     {
       static_assert(std::is_same<TT,T>::value,"Error [ImageSegmentation::conv2]: Cannot change the underlying type.");
-      int x,y,dx,dy;
-      int imageX,imageY;
-      double sumFilter=0,sumInside;
+      this->conv2(source,filter,filterCenterZ.x,filterCenterZ.y,boundariesNormalizeBrightness,method,numofThreads);
+    }
+    /** Implements Matlab function conv2(source,filter,'same') and stores the result into this image.
+     *  This image is reallocated to the size of _source_, which may be a view of this image. If _source_ is not a view
+     *  of this image and the size does not change, the result is written into the current pixels of this image without
+     *  allocating a temporary image, so iterative filters can alternate between two images (a.conv2(b.view(),f);
+     *  b.conv2(a.view(),f);).
+     *  This method is defined only if the underlying type T of the segmentation/image is arithmetic.
+     *  @param source Convolved image or its part.
+     *  @param filter Convolution filter.
+     *  @param filterCenterX X coordinate of the center pixel of the filter.
+     *  @param filterCenterY Y coordinate of the center pixel of the filter.  
+     *  @param boundariesNormalizeBrightness If true, pixels near image boundary are convolved using only 
+     *         a "valid" part of the filter, which overlaps with the image. False is equivalent to zero-padding.
+     *  @param method Algorithm of the convolution, the results of the algorithms differ only by rounding errors.
+     *  @param numofThreads Number of threads, values <=0 mean the number of hardware threads.
+     */
+    template <class TT=T> void conv2(const typename std::enable_if<std::is_arithmetic<TT>::value,view_type>::type &source,const ImageSegmentation<T,N,Layout> &filter,int filterCenterX,int filterCenterY,bool boundariesNormalizeBrightness=true,
+                                     Conv2Method method=Conv2Method::Auto,int numofThreads=0)
+    {
+      static_assert(std::is_same<TT,T>::value,"Error [ImageSegmentation::conv2]: Cannot change the underlying type.");
+      if(this->shares_pixels(source) || &filter==this)
+      {
+        ImageSegmentation<T,N,Layout> tmp(this->verbose);
+        conv2_kernel(source,filter,filterCenterX,filterCenterY,boundariesNormalizeBrightness,method,numofThreads,tmp);
+        this->swap_data(tmp);
+      }
+      else conv2_kernel(source,filter,filterCenterX,filterCenterY,boundariesNormalizeBrightness,method,numofThreads,*this);
+    }
+    //-------------------------------------------------------------------------
+    /** Implements Matlab function conv2(columnFilter,rowFilter,this,'same'), i.e. the convolution with separable filter
+     *  whose pixel \[x,y\] is _columnFilter_\[y\]*_rowFilter_\[x\], computed by two 1D passes.
+     *  This method is defined only if the underlying type T of the segmentation/image is arithmetic.
+     *  @param columnFilter Vertical (column) part of the filter.
+     *  @param rowFilter Horizontal (row) part of the filter.
+     *  @param boundariesNormalizeBrightness If true, pixels near image boundary are convolved using only
+     *         a "valid" part of the filter, which overlaps with the image. False is equivalent to zero-padding.
+     *  @param numofThreads Number of threads, values <=0 mean the number of hardware threads.
+     *  @throw DimensionException if one of the filters is empty.
+     */
+    template <class TT=T> void conv2(const typename std::enable_if<std::is_arithmetic<TT>::value,std::vector<T> >::type &columnFilter,const std::vector<T> &rowFilter,
+                                     bool boundariesNormalizeBrightness=true,int numofThreads=0)
+    {
+      static_assert(std::is_same<TT,T>::value,"Error [ImageSegmentation::conv2]: Cannot change the underlying type.");
+      this->conv2(columnFilter,rowFilter,(int)rowFilter.size()/2,(int)columnFilter.size()/2,boundariesNormalizeBrightness,numofThreads);
+    }
+    /** Implements Matlab function conv2(columnFilter,rowFilter,this,'same').
+     *  @param filterCenterX Index of the center of _rowFilter_.
+     *  @param filterCenterY Index of the center of _columnFilter_.
+     *  @see conv2(const std::vector<T> &columnFilter,const std::vector<T> &rowFilter,bool boundariesNormalizeBrightness,int numofThreads)
+     */
+    template <class TT=T> void conv2(const typename std::enable_if<std::is_arithmetic<TT>::value,std::vector<T> >::type &columnFilter,const std::vector<T> &rowFilter,
+                                     int filterCenterX,int filterCenterY,bool boundariesNormalizeBrightness=true,int numofThreads=0)
+    {
+      static_assert(std::is_same<TT,T>::value,"Error [ImageSegmentation::conv2]: Cannot change the underlying type.");
+      ImageSegmentation<T,N,Layout> tmp(this->verbose);
+      conv2_separable_kernel(this->view(),columnFilter,rowFilter,filterCenterX,filterCenterY,boundariesNormalizeBrightness,numofThreads,tmp);
+      this->swap_data(tmp);
+    }
+    /** Implements Matlab function conv2(columnFilter,rowFilter,source,'same') and stores the result into this image.
+     *  This image is reallocated to the size of _source_, which may be a view of this image. If _source_ is not a view
+     *  of this image and the size does not change, the result is written into the current pixels of this image.
+     *  @see conv2(const std::vector<T> &columnFilter,const std::vector<T> &rowFilter,bool boundariesNormalizeBrightness,int numofThreads)
+     */
+    template <class TT=T> void conv2(const typename std::enable_if<std::is_arithmetic<TT>::value,view_type>::type &source,
+                                     const std::vector<T> &columnFilter,const std::vector<T> &rowFilter,bool boundariesNormalizeBrightness=true,
+                                     int numofThreads=0)
+    {
+      static_assert(std::is_same<TT,T>::value,"Error [ImageSegmentation::conv2]: Cannot change the underlying type.");
+      this->conv2(source,columnFilter,rowFilter,(int)rowFilter.size()/2,(int)columnFilter.size()/2,boundariesNormalizeBrightness,numofThreads);
+    }
+    /** Implements Matlab function conv2(columnFilter,rowFilter,source,'same') and stores the result into this image.
+     *  @see conv2(const std::vector<T> &columnFilter,const std::vector<T> &rowFilter,int filterCenterX,int filterCenterY,bool boundariesNormalizeBrightness,int numofThreads)
+     */
+    template <class TT=T> void conv2(const typename std::enable_if<std::is_arithmetic<TT>::value,view_type>::type &source,
+                                     const std::vector<T> &columnFilter,const std::vector<T> &rowFilter,
+                                     int filterCenterX,int filterCenterY,bool boundariesNormalizeBrightness=true,int numofThreads=0)
+    {
+      static_assert(std::is_same<TT,T>::value,"Error [ImageSegmentation::conv2]: Cannot change the underlying type.");
+      if(this->shares_pixels(source))
+      {
+        ImageSegmentation<T,N,Layout> tmp(this->verbose);
+        conv2_separable_kernel(source,columnFilter,rowFilter,filterCenterX,filterCenterY,boundariesNormalizeBrightness,numofThreads,tmp);
+        this->swap_data(tmp);
+      }
+      else conv2_separable_kernel(source,columnFilter,rowFilter,filterCenterX,filterCenterY,boundariesNormalizeBrightness,numofThreads,*this);
+    }
+    //-------------------------------------------------------------------------
+    protected:
+    /** Filters of rank 1 (Gaussian, box, Sobel, ...) are convolved by conv2_separable_kernel, large filters by conv2_fft_kernel.
+     */
+    static void conv2_kernel(const view_type &source,const ImageSegmentation<T,N,Layout> &filter,int filterCenterX,int filterCenterY,bool boundariesNormalizeBrightness,
+                             Conv2Method method,int numofThreads,ImageSegmentation<T,N,Layout> &res)
+    {
+      Conv2Scratch &scratch=conv2_scratch();
+      if((method==Conv2Method::Auto || method==Conv2Method::Separable) &&
+         filter.width>1 && filter.height>1 && separate_filter(filter,scratch.columnFilter,scratch.rowFilter))
+      {
+        conv2_separable_kernel(source,scratch.columnFilter,scratch.rowFilter,filterCenterX,filterCenterY,boundariesNormalizeBrightness,numofThreads,res);
+        return;
+      }
+      bool centerInside=filterCenterX>=0 && filterCenterY>=0 && filterCenterX<filter.width && filterCenterY<filter.height;
+      if(centerInside && (method==Conv2Method::FFT || (method==Conv2Method::Auto && filter.numof_pixels()>=(std::size_t)fftConv2MinFilterPixels)))
+      {
+        conv2_fft_kernel(source,filter,filterCenterX,filterCenterY,boundariesNormalizeBrightness,numofThreads,res);
+        return;
+      }
+      conv2_direct_kernel(source,filter,filterCenterX,filterCenterY,boundariesNormalizeBrightness,numofThreads,res);
+    }
+    /** Direct convolution, the lines (columns for ColumnMajor, rows for RowMajor) of the result are distributed among
+     *  _numofThreads_ threads. Pixels whose neighbourhood covered by the filter lies inside the image are computed
+     *  line by line without bounds checking by conv2_accumulate, pixels near the image boundary one by one.
+     *  The filter taps are added in the same order in both cases, so the result does not depend on the split.
+     *  The sums of the valid parts of the filter (boundary brightness normalization) are taken from the summed-area
+     *  table of the filter.
+     */
+    static void conv2_direct_kernel(const view_type &source,const ImageSegmentation<T,N,Layout> &filter,int filterCenterX,int filterCenterY,
+                                    bool boundariesNormalizeBrightness,int numofThreads,ImageSegmentation<T,N,Layout> &res)
+    {
+      double sumFilter=0;
+      std::vector<double> sums;
       if(boundariesNormalizeBrightness)
-        for(x=0;x<filter.width;x++)
-          for(y=0;y<filter.height;y++)
-            sumFilter+=filter.data[x][y];
-      ImageSegmentation<T,N> tmp(this->width,this->height);
-      int startDX,endDX,startDY,endDY;
-      for(x=0;x<this->width;x++)
-      {
-        for(y=0;y<this->height;y++)
+      {
+        for(std::size_t i=0;i<filter.numof_pixels();i++)
+          sumFilter+=filter.buffer[i];
+        sums=conv2_filter_sums(filter);
+      }
+      res.reallocate(source.width,source.height);
+      auto convolve_pixel=[&](int x,int y)
+      {
+        color_type &r=res.data[x][y];
+        int startDX=std::max(0,x+filterCenterX-source.width+1);
+        int startDY=std::max(0,y+filterCenterY-source.height+1);
+        int endDX=std::min(filter.width-1,x+filterCenterX);
+        int endDY=std::min(filter.height-1,y+filterCenterY);
+        r=0;
+        Layout::traverse(startDX,startDY,endDX,endDY,[&](int dx,int dy)
+        {
+          r+=source.data[x-(dx-filterCenterX)][y-(dy-filterCenterY)]*filter.data[dx][dy];
+        });
+        if(boundariesNormalizeBrightness)
+        {
+          double sumInside=conv2_filter_sum(sums,filter.width,startDX,startDY,endDX,endDY);
+          if(sumInside<1e-10) r=source.data[x][y];
+          else r*=(sumFilter/sumInside);
+        }
+      };
+      //pixels [x1,y1]-[x2,y2] see the whole filter, for them sumInside==sumFilter
+      int x1=std::max(0,filter.width-1-filterCenterX),x2=std::min(source.width-1,source.width-1-filterCenterX);
+      int y1=std::max(0,filter.height-1-filterCenterY),y2=std::min(source.height-1,source.height-1-filterCenterY);
+      bool copyInterior=boundariesNormalizeBrightness && sumFilter<1e-10;
+      //positions of the pixels under the filter taps relative to the convolved pixel, in the order of convolve_pixel
+      std::vector<std::ptrdiff_t> tapOffsets;
+      std::vector<color_type> tapValues;
+      Layout::traverse(0,0,filter.width-1,filter.height-1,[&](int dx,int dy)
+      {
+        std::ptrdiff_t ox=filterCenterX-dx,oy=filterCenterY-dy;
+        tapOffsets.push_back(Layout::rowMajor?oy*source.stride+ox:ox*source.stride+oy);
+        tapValues.push_back(filter.data[dx][dy]);
+      });
+      int numofLines=Layout::rowMajor?source.height:source.width;
+      int lineLength=Layout::rowMajor?source.width:source.height;
+      int line1=Layout::rowMajor?y1:x1,line2=Layout::rowMajor?y2:x2,pos1=Layout::rowMajor?x1:y1,pos2=Layout::rowMajor?x2:y2;
+      const int chunkLength=512;
+      parallel_for(numofLines,numofThreads,[&](int line)
+      {
+        auto convolve_position=[&](int pos){if(Layout::rowMajor) convolve_pixel(pos,line); else convolve_pixel(line,pos);};
+        if(line<line1 || line>line2 || pos1>pos2)
+        {
+          for(int pos=0;pos<lineLength;pos++) convolve_position(pos);
+          return;
+        }
+        for(int pos=0;pos<pos1;pos++) convolve_position(pos);
+        color_type *dst=res.buffer+(std::size_t)line*res.stride;
+        const color_type *src=source.buffer+(std::size_t)line*source.stride;
+        if(copyInterior) std::copy(src+pos1,src+pos2+1,dst+pos1);
+        else
+        {
+          //chunks of the line stay in the cache during the pass over the taps
+          for(int pos=pos1;pos<=pos2;pos+=chunkLength)
+          {
+            int n=std::min(chunkLength,pos2-pos+1);
+            std::fill(dst+pos,dst+pos+n,color_type(0));
+            for(std::size_t i=0;i<tapValues.size();i++) conv2_accumulate(dst+pos,src+pos+tapOffsets[i],tapValues[i],n);
+          }
+        }
+        for(int pos=pos2+1;pos<lineLength;pos++) convolve_position(pos);
+      });
+    }
+    ///_dst_\[i\]+=_src_\[i\]*_value_ for i=0,...,_n_-1.
+    template <class C,class V> static void conv2_accumulate(C *dst,const C *src,V value,int n)
+    {
+      for(int i=0;i<n;i++) dst[i]+=src[i]*value;
+    }
+    ///@see conv2_accumulate, vectorized by AVX or SSE2 if available.
+    static void conv2_accumulate(float *dst,const float *src,float value,int n)
+    {
+      int i=0;
+      #if defined(__AVX__)
+        __m256 v=_mm256_set1_ps(value);
+        for(;i+8<=n;i+=8) _mm256_storeu_ps(dst+i,_mm256_add_ps(_mm256_loadu_ps(dst+i),_mm256_mul_ps(_mm256_loadu_ps(src+i),v)));
+      #elif defined(__SSE2__)
+        __m128 v=_mm_set1_ps(value);
+        for(;i+4<=n;i+=4) _mm_storeu_ps(dst+i,_mm_add_ps(_mm_loadu_ps(dst+i),_mm_mul_ps(_mm_loadu_ps(src+i),v)));
+      #endif
+      for(;i<n;i++) dst[i]+=src[i]*value;
+    }
+    ///@see conv2_accumulate, vectorized by AVX or SSE2 if available.
+    static void conv2_accumulate(double *dst,const double *src,double value,int n)
+    {
+      int i=0;
+      #if defined(__AVX__)
+        __m256d v=_mm256_set1_pd(value);
+        for(;i+4<=n;i+=4) _mm256_storeu_pd(dst+i,_mm256_add_pd(_mm256_loadu_pd(dst+i),_mm256_mul_pd(_mm256_loadu_pd(src+i),v)));
+      #elif defined(__SSE2__)
+        __m128d v=_mm_set1_pd(value);
+        for(;i+2<=n;i+=2) _mm_storeu_pd(dst+i,_mm_add_pd(_mm_loadu_pd(dst+i),_mm_mul_pd(_mm_loadu_pd(src+i),v)));
+      #endif
+      for(;i<n;i++) dst[i]+=src[i]*value;
+    }
+    /** Working memory of conv2_kernel and conv2_separable_kernel. Each thread keeps its own between the calls, so repeated
+     *  convolutions of images of the same size by separable filters do not allocate any memory.
+     */
+    struct Conv2Scratch
+    {
+      ///1D parts of the filter, see separate_filter.
+      std::vector<T> columnFilter,rowFilter;
+      ///Sums of the valid parts of the 1D filters along and across the lines.
+      std::vector<double> lineSums,crossSums;
+      ///Blocks of the lines of the result, one per thread, see conv2_separable_kernel.
+      std::vector<std::vector<color_type> > blocks;
+    };
+    ///Conv2Scratch of the calling thread.
+    static Conv2Scratch& conv2_scratch()
+    {
+      thread_local Conv2Scratch scratch;
+      return(scratch);
+    }
+    /** Convolution by the separable filter _columnFilter_\[y\]*_rowFilter_\[x\]. The lines of the image (rows for RowMajor,
+     *  columns for ColumnMajor) are convolved by the corresponding 1D filter directly into _res_ (see conv2_line), then
+     *  blocks of blockLength positions of all lines are copied to a scratch buffer and convolved across the lines back
+     *  into _res_. The lines and then the blocks are distributed among _numofThreads_ threads. Apart from _res_, only the
+     *  buffers of conv2_scratch of the calling thread are used. The sums of the valid parts of the filter (boundary
+     *  brightness normalization, see conv2_kernel) are products of the sums of the valid parts of the 1D filters.
+     *  _res_ must not share pixels with _source_.
+     */
+    static void conv2_separable_kernel(const view_type &source,const std::vector<T> &columnFilter,const std::vector<T> &rowFilter,
+                                       int filterCenterX,int filterCenterY,bool boundariesNormalizeBrightness,int numofThreads,
+                                       ImageSegmentation<T,N,Layout> &res)
+    {
+      if(columnFilter.empty() || rowFilter.empty())
+        throw(DimensionException(compose_message(Message::Error,"ImageSegmentation::conv2","The filter is empty.")));
+      const std::vector<T> &lineFilter=Layout::rowMajor?rowFilter:columnFilter;
+      const std::vector<T> &crossFilter=Layout::rowMajor?columnFilter:rowFilter;
+      int lineCenter=Layout::rowMajor?filterCenterX:filterCenterY,crossCenter=Layout::rowMajor?filterCenterY:filterCenterX;
+      int numofLines=Layout::rowMajor?source.height:source.width;
+      int lineLength=Layout::rowMajor?source.width:source.height;
+      int crossLength=(int)crossFilter.size();
+      Conv2Scratch &scratch=conv2_scratch();
+      double sumFilter=0;
+      if(boundariesNormalizeBrightness)
+      {
+        sumFilter=conv2_separable_sums(lineFilter,lineCenter,lineLength,scratch.lineSums)*
+                  conv2_separable_sums(crossFilter,crossCenter,numofLines,scratch.crossSums);
+      }
+      res.reallocate(source.width,source.height);
+      parallel_for(numofLines,numofThreads,[&](int line)
+      {
+        conv2_line(source.buffer+(std::size_t)line*source.stride,lineLength,lineFilter,lineCenter,res.buffer+(std::size_t)line*res.stride);
+      });
+      const int blockLength=64;
+      int numofBlocks=(lineLength+blockLength-1)/blockLength;
+      int numofRanges=std::max(1,std::min(resolve_numof_threads(numofThreads),numofBlocks));
+      if((int)scratch.blocks.size()<numofRanges) scratch.blocks.resize(numofRanges);
+      parallel_ranges(numofBlocks,numofRanges,[&](int t,int firstBlock,int endBlock)
+      {
+        std::vector<color_type> &block=scratch.blocks[t];
+        for(int pos=firstBlock*blockLength;pos<std::min(endBlock*blockLength,lineLength);pos+=blockLength)
+        {
+          int n=std::min(blockLength,lineLength-pos);
+          block.resize((std::size_t)numofLines*n);
+          for(int line=0;line<numofLines;line++)
+          {
+            const color_type *src=res.buffer+(std::size_t)line*res.stride+pos;
+            std::copy(src,src+n,block.data()+(std::size_t)line*n);
+          }
+          for(int line=0;line<numofLines;line++)
+          {
+            color_type *dst=res.buffer+(std::size_t)line*res.stride+pos;
+            int start=std::max(0,line+crossCenter-numofLines+1),end=std::min(crossLength-1,line+crossCenter);
+            std::fill(dst,dst+n,color_type(0));
+            for(int d=start;d<=end;d++) conv2_accumulate(dst,block.data()+(std::size_t)(line+crossCenter-d)*n,crossFilter[d],n);
+            if(!boundariesNormalizeBrightness) continue;
+            const color_type *src=source.buffer+(std::size_t)line*source.stride+pos;
+            for(int i=0;i<n;i++)
+            {
+              double sumInside=scratch.lineSums[pos+i]*scratch.crossSums[line];
+              if(sumInside<1e-10) dst[i]=src[i];
+              else dst[i]*=(sumFilter/sumInside);
+            }
+          }
+        }
+      });
+    }
+    /** 1D convolution of the _length_ pixels at _src_ by _filter_ with center _center_ (zero-padding), the result is
+     *  stored to _dst_. The pixels for which the whole filter lies inside the line are computed by conv2_accumulate.
+     */
+    static void conv2_line(const color_type *src,int length,const std::vector<T> &filter,int center,color_type *dst)
+    {
+      int filterLength=(int)filter.size();
+      auto convolve_pixel=[&](int pos)
+      {
+        int start=std::max(0,pos+center-length+1),end=std::min(filterLength-1,pos+center);
+        color_type r=0;
+        for(int d=start;d<=end;d++) r+=src[pos+center-d]*filter[d];
+        dst[pos]=r;
+      };
+      int pos1=std::max(0,filterLength-1-center),pos2=std::min(length-1,length-1-center);
+      if(pos1>pos2)
+      {
+        for(int pos=0;pos<length;pos++) convolve_pixel(pos);
+        return;
+      }
+      for(int pos=0;pos<pos1;pos++) convolve_pixel(pos);
+      const int chunkLength=512;
+      for(int pos=pos1;pos<=pos2;pos+=chunkLength)
+      {
+        int n=std::min(chunkLength,pos2-pos+1);
+        std::fill(dst+pos,dst+pos+n,color_type(0));
+        for(int d=0;d<filterLength;d++) conv2_accumulate(dst+pos,src+pos+center-d,filter[d],n);
+      }
+      for(int pos=pos2+1;pos<length;pos++) convolve_pixel(pos);
+    }
+    /** Sums of the valid parts of 1D filter _filter_ with center _center_ for the positions 0,...,_length_-1 of a line
+     *  of _length_ pixels are stored to _res_.
+     *  @return Sum of the whole filter.
+     */
+    static double conv2_separable_sums(const std::vector<T> &filter,int center,int length,std::vector<double> &res)
+    {
+      int filterLength=(int)filter.size();
+      res.resize(length);
+      for(int pos=0;pos<length;pos++)
+      {
+        res[pos]=0;
+        for(int d=std::max(0,pos+center-length+1);d<=std::min(filterLength-1,pos+center);d++) res[pos]+=filter[d];
+      }
+      double ret=0;
+      for(auto &&it: filter) ret+=it;
+      return(ret);
+    }
+    /** Convolution by FftConvolution, the sums of the valid parts of the filter (boundary brightness normalization,
+     *  see conv2_kernel) are taken from the summed-area table of the filter. The results of integer types are rounded.
+     */
+    static void conv2_fft_kernel(const view_type &source,const ImageSegmentation<T,N,Layout> &filter,int filterCenterX,int filterCenterY,
+                                 bool boundariesNormalizeBrightness,int numofThreads,ImageSegmentation<T,N,Layout> &res)
+    {
+      int filterWidth=filter.width,filterHeight=filter.height;
+      std::vector<double> rowMajorFilter(filter.numof_pixels()),sums=conv2_filter_sums(filter);
+      double sumFilter=0;
+      for(std::size_t i=0;i<filter.numof_pixels();i++) sumFilter+=filter.buffer[i];
+      filter.traverse([&](int x,int y){rowMajorFilter[(std::size_t)y*filterWidth+x]=filter.data[x][y];});
+      FftConvolution convolution(rowMajorFilter,filterWidth,filterHeight,filterCenterX,filterCenterY,source.width,source.height);
+      res.reallocate(source.width,source.height);
+      convolution.convolve([&](int y,double *dst)
+      {
+        for(int x=0;x<source.width;x++) dst[x]=(double)source.data[x][y];
+      },[&](int y,const double *src)
+      {
+        int startDY=std::max(0,y+filterCenterY-source.height+1);
+        int endDY=std::min(filterHeight-1,y+filterCenterY);
+        for(int x=0;x<source.width;x++)
         {
-          tmp.data[x][y]=0;
-          sumInside=0;
-          startDX=std::max(0,x+filterCenterX-this->width+1);
-          startDY=std::max(0,y+filterCenterY-this->height+1);
-          endDX=std::min(filter.width-1,x+filterCenterX);
-          endDY=std::min(filter.height-1,y+filterCenterY);
-          for(dx=startDX;dx<=endDX;dx++)
-          {
-            for(dy=startDY;dy<=endDY;dy++)
-            {
-              imageX=x-(dx-filterCenterX);
-              imageY=y-(dy-filterCenterY);
-              tmp.data[x][y]+=this->data[imageX][imageY]*filter.data[dx][dy];
-              sumInside+=filter.data[dx][dy];
-            }
-          }
+          color_type &r=res.data[x][y];
+          r=round_sample(src[x]);
           if(boundariesNormalizeBrightness)
           {
-            if(sumInside<1e-10) tmp.data[x][y]=this->data[x][y];
-            else tmp.data[x][y]*=(sumFilter/sumInside);
+            int startDX=std::max(0,x+filterCenterX-source.width+1);
+            int endDX=std::min(filterWidth-1,x+filterCenterX);
+            double sumInside=conv2_filter_sum(sums,filterWidth,startDX,startDY,endDX,endDY);
+            if(sumInside<1e-10) r=source.data[x][y];
+            else r*=(sumFilter/sumInside);
           }
         }
+      },numofThreads);
+    }
+    /** Summed-area table of _filter_, element \[(y+1)*(filter.width+1)+x+1\] is the sum of rectangle \[0,0\]-\[x,y\]
+     *  of the filter and the elements of the first row and column are zeros.
+     */
+    static std::vector<double> conv2_filter_sums(const ImageSegmentation<T,N,Layout> &filter)
+    {
+      int w=filter.width+1;
+      std::vector<double> sums((std::size_t)w*(filter.height+1),0);
+      for(int y=0;y<filter.height;y++)
+      {
+        double rowSum=0;
+        for(int x=0;x<filter.width;x++)
+        {
+          rowSum+=filter.data[x][y];
+          sums[(std::size_t)(y+1)*w+x+1]=sums[(std::size_t)y*w+x+1]+rowSum;
+        }
+      }
+      return(sums);
+    }
+    /** Sum of rectangle \[_x1_,_y1_\]-\[_x2_,_y2_\] of a filter of width _filterWidth_ with summed-area table _sums_.
+     *  The rectangle lies inside the filter or it is empty.
+     */
+    static double conv2_filter_sum(const std::vector<double> &sums,int filterWidth,int x1,int y1,int x2,int y2)
+    {
+      if(x1>x2 || y1>y2) return(0);
+      int w=filterWidth+1;
+      return(sums[(std::size_t)(y2+1)*w+x2+1]-sums[(std::size_t)y1*w+x2+1]-sums[(std::size_t)(y2+1)*w+x1]+sums[(std::size_t)y1*w+x1]);
+    }
+    ///_v_ rounded to the nearest integer for integer types, _v_ otherwise.
+    template <class TT=T> static typename std::enable_if<std::is_integral<TT>::value,T>::type round_sample(double v){return((T)std::llround(v));}
+    ///@see round_sample
+    template <class TT=T> static typename std::enable_if<!std::is_integral<TT>::value,T>::type round_sample(double v){return((T)v);}
+    /** Decompose _filter_ into _columnFilter_ and _rowFilter_ such that _filter_\[x\]\[y\]==_columnFilter_\[y\]*_rowFilter_\[x\].
+     *  Integer filters are decomposed only into integer 1D filters, so the convolution gives exactly the same result as
+     *  the 2D convolution.
+     *  @return False if _filter_ does not have rank 1.
+     */
+    template <class TT=T> static typename std::enable_if<std::is_integral<TT>::value,bool>::type
+    separate_filter(const ImageSegmentation<T,N,Layout> &filter,std::vector<T> &columnFilter,std::vector<T> &rowFilter)
+    {
+      int pivotX=0,pivotY=0;
+      long long pivot=0;
+      filter.traverse([&](int x,int y)
+      {
+        long long f=(long long)filter.data[x][y];
+        if((f<0?-f:f)>(pivot<0?-pivot:pivot)) {pivot=f;pivotX=x;pivotY=y;}
+      });
+      if(pivot==0) return(false);
+      //filter[x][y]==(filter[pivotX][y]/g)*(filter[x][pivotY]*g/pivot), g is the greatest common divisor of column pivotX
+      long long g=0;
+      for(int y=0;y<filter.height;y++)
+      {
+        long long a=(long long)filter.data[pivotX][y],b=g;
+        a=a<0?-a:a;
+        while(b!=0) {long long t=a%b;a=b;b=t;}
+        g=a;
+      }
+      //|columnFilter[y]|<=|filter[pivotX][y]| and |rowFilter[x]|<=g, so both fit into T
+      columnFilter.resize(filter.height);
+      rowFilter.resize(filter.width);
+      for(int y=0;y<filter.height;y++) columnFilter[y]=(T)((long long)filter.data[pivotX][y]/g);
+      for(int x=0;x<filter.width;x++)
+      {
+        long long f=(long long)filter.data[x][pivotY]*g;
+        if(f%pivot!=0) return(false);
+        rowFilter[x]=(T)(f/pivot);
       }
-      for(x=0;x<this->width;x++)
-        for(y=0;y<this->height;y++)
-          this->data[x][y]=tmp.data[x][y];
+      for(int y=0;y<filter.height;y++)
+        for(int x=0;x<filter.width;x++)
+          if((long long)columnFilter[y]*(long long)rowFilter[x]!=(long long)filter.data[x][y]) return(false);
+      return(true);
     }
+    /** @see separate_filter
+     *  Floating point filters are decomposed up to the rounding errors, which are comparable to the rounding errors of the
+     *  convolution.
+     */
+    template <class TT=T> static typename std::enable_if<!std::is_integral<TT>::value,bool>::type
+    separate_filter(const ImageSegmentation<T,N,Layout> &filter,std::vector<T> &columnFilter,std::vector<T> &rowFilter)
+    {
+      int pivotX=0,pivotY=0;
+      T pivot=0;
+      filter.traverse([&](int x,int y)
+      {
+        if(std::abs(filter.data[x][y])>std::abs(pivot)) {pivot=filter.data[x][y];pivotX=x;pivotY=y;}
+      });
+      if(pivot==0) return(false);
+      columnFilter.resize(filter.height);
+      rowFilter.resize(filter.width);
+      for(int y=0;y<filter.height;y++) columnFilter[y]=filter.data[pivotX][y];
+      for(int x=0;x<filter.width;x++) rowFilter[x]=filter.data[x][pivotY]/pivot;
+      T tolerance=16*std::numeric_limits<T>::epsilon()*std::abs(pivot);
+      for(int y=0;y<filter.height;y++)
+        for(int x=0;x<filter.width;x++)
+          if(std::abs(columnFilter[y]*rowFilter[x]-filter.data[x][y])>tolerance) return(false);
+      return(true);
+    }
+    public:
     //-------------------------------------------------------------------------
     /** Flood fill algorithm.
      *  @param startZ Starting point.
@@ -1160,30 +2504,79 @@ namespace LibImageSegmentation
     void load(const typename std::enable_if<NN==DefaultTypes::SegmentationN,std::string>::type &filename,const Palette<PT,PN> &palette)
     {
       static_assert(NN==N,"Error [ImageSegmentation::load]: Cannot change the number of channels.");
-      int x,y;
       __PrivateCImgWrapper<DefaultTypes::int_type> cimg(filename);
+      this->import_cimg(cimg,filename,palette);
+    }
+    //-------------------------------------------------------------------------
+    /** Load rectangle \[_z1_,_z2_\] of a segmentation/image from file, only every _step_-th row and column is loaded
+     *  The parts of the rectangle outside the image are omitted (the same as by cut), so pixel \[x,y\] of the result is pixel
+     *  \[x1+x*_step_,y1+y*_step_\] of the file, where \[x1,y1\]=\[max(_z1_.x,0),max(_z1_.y,0)\] is the clipped corner. Only the rectangle is allocated,
+     *  TIFF files (strips and tiles) and native files decode only the strips/tiles/rows which intersect the rectangle,
+     *  PNG files are decoded up to the last row of the rectangle, other formats are loaded whole by CImg and cut.
+     *  @param args The remaining arguments of the corresponding load(filename,...), e.g. a palette or the bitdepth.
+     */
+    template <class... Args> void load(const std::string &filename,const Pixel<int> &z1,const Pixel<int> &z2,int step,Args&&... args)
+    {
+      __PrivateCImgWrapper<DefaultTypes::int_type> cimg(filename,z1.x,z1.y,z2.x,z2.y,step);
+      this->import_cimg(cimg,filename,std::forward<Args>(args)...);
+    }
+    /** Load every _step_-th row and column of a segmentation/image from file, e.g. for thumbnails.
+     *  @see load(const std::string &filename,const Pixel<int> &z1,const Pixel<int> &z2,int step,Args&&... args)
+     */
+    template <class... Args> void load_decimated(const std::string &filename,int step,Args&&... args)
+    {
+      this->load(filename,Pixel<int>(0,0),Pixel<int>(std::numeric_limits<int>::max(),std::numeric_limits<int>::max()),step,std::forward<Args>(args)...);
+    }
+    //-------------------------------------------------------------------------
+    protected:
+    ///Set this segmentation from loaded file _cimg_ using the standard palette.
+    template <int NN=N> 
+    void import_cimg(const __PrivateCImgWrapper<DefaultTypes::int_type> &cimg,const typename std::enable_if<NN==DefaultTypes::SegmentationN,std::string>::type &filename)
+    {
+      StandardPalette sp;
+      this->import_cimg(cimg,filename,sp);
+    }
+    ///Set this segmentation from loaded file _cimg_ using a custom palette.
+    template <class PT,std::size_t PN,int NN=N> 
+    void import_cimg(const __PrivateCImgWrapper<DefaultTypes::int_type> &cimg,
+                     const typename std::enable_if<NN==DefaultTypes::SegmentationN,std::string>::type &filename,const Palette<PT,PN> &palette)
+    {
       this->reallocate(cimg.width,cimg.height);
       if(cimg.spectrum==1)
       {
-        for(x=0;x<this->width;x++)
-          for(y=0;y<this->height;y++)
-            cimg.get(x,y,this->data[x][y]);
-        if(this->verbose>=Verbose::Normal) std::cerr << compose_message(Message::Note,"ImageSegmentation::load","1 channel segmentation loaded correctly from "+filename) << "\n";
-      }
-      else if(cimg.spectrum==palette.spectrum)
-      {
-        std::vector<int> color;
-        for(x=0;x<this->width;x++)
+        int numofOOR=0;
+        this->import_planes(cimg,1,[&](color_type &pixel,const DefaultTypes::int_type *const *planes,std::size_t i)
+        {
+          DefaultTypes::int_type l=planes[0][i];
+          if(!is_label_representable(l)) {l=palette.colorNotRecognized;numofOOR++;}
+          pixel=(color_type)l;
+        });
+        if(this->verbose>=Verbose::Normal)
         {
-          for(y=0;y<this->height;y++)
+          if(numofOOR>0)
           {
-            cimg.get(x,y,color);
-            this->data[x][y]=palette.get_color_index(color);
+            std::cerr << compose_message(Message::Warning,
+                                         "ImageSegmentation::load",
+                                         "1 channel segmentation loaded from "+filename+" but there are "+
+                                         std::to_string(numofOOR)+" pixels with labels that do not fit into the label type.") << "\n";
           }
+          else std::cerr << compose_message(Message::Note,"ImageSegmentation::load","1 channel segmentation loaded correctly from "+filename) << "\n";
         }
+      }
+      else if(cimg.spectrum==palette.spectrum)
+      {
+        PaletteLookup<PT,PN> lookup(palette);
+        std::array<DefaultTypes::int_type,PN> color;
+        int numofNR=0;
+        this->import_planes(cimg,PN,[&](color_type &pixel,const DefaultTypes::int_type *const *planes,std::size_t i)
+        {
+          for(std::size_t c=0;c<PN;c++) color[c]=planes[c][i];
+          int index=lookup.get_color_index(color);
+          if(index==palette.colorNotRecognized) numofNR++;
+          pixel=(color_type)index;
+        });
         if(this->verbose>=Verbose::Normal)
         {
-          int numofNR=this->count_label(palette.colorNotRecognized);
           if(numofNR>0) 
           {
             std::cerr << compose_message(Message::Warning,
@@ -1199,9 +2592,110 @@ namespace LibImageSegmentation
         throw(BadSegmentationFormatException(palette.spectrum,cimg.spectrum,filename));
       }
     }
-    //-------------------------------------------------------------------------
-    protected:
     double bitdepth_2_norm(int bitdepth)const {if(bitdepth<0) {bitdepth+=9;}return((1<<bitdepth)-1);}
+    ///Determines, whether label _l_ read from a file fits into the underlying type T.
+    static bool is_label_representable(DefaultTypes::int_type l)
+    {
+      if(!std::is_integral<T>::value || sizeof(T)>=sizeof(l)) return(true);
+      return(l>=(DefaultTypes::int_type)std::numeric_limits<T>::lowest() && l<=(DefaultTypes::int_type)std::numeric_limits<T>::max());
+    }
+    /** Set all pixels from the channel planes of _cimg_, which has the same dimensions as this image.
+     *  _f_ is called as f(pixel,planes,i), where _planes_ are the first pixels of channels 0..._numofPlanes_-1
+     *  of _cimg_ and _i_ is the position of the pixel in each plane. A 1 channel _cimg_ provides its only plane
+     *  as all channels and missing channels are nullptr (the same rules as __PrivateCImgWrapper::_get).
+     *  The RowMajor buffer is filled in one sequential pass, the ColumnMajor buffer in square blocks
+     *  so that both the planes and the columns are read and written in cache-friendly runs.
+     */
+    template <class CT,class F> void import_planes(const __PrivateCImgWrapper<CT> &cimg,int numofPlanes,F f)
+    {
+      std::vector<const CT*> planes(std::max(numofPlanes,1),nullptr);
+      for(int c=0;c<numofPlanes;c++) planes[c]=cimg.plane(cimg.spectrum==1?0:c);
+      const CT *const *p=planes.data();
+      if(Layout::rowMajor)
+      {
+        for(std::size_t i=0;i<this->numof_pixels();i++) f(this->buffer[i],p,i);
+      }
+      else
+      {
+        const int block=64;
+        for(int y0=0;y0<this->height;y0+=block)
+        {
+          int y1=std::min(y0+block,this->height);
+          for(int x=0;x<this->width;x++)
+          {
+            color_type *column=this->buffer+Layout::offset(x,0,this->stride);
+            for(int y=y0;y<y1;y++) f(column[y],p,(std::size_t)y*this->width+x);
+          }
+        }
+      }
+    }
+    //-------------------------------------------------------------------------
+    ///@see load(const typename std::enable_if<NN==DefaultTypes::SegmentationBlackWhiteN,std::string>::type &filename,int bitdepth)
+    template <int NN=N>
+    void import_cimg(const __PrivateCImgWrapper<DefaultTypes::int_type> &cimg,
+                     const typename std::enable_if<NN==DefaultTypes::SegmentationBlackWhiteN,std::string>::type &filename,int bitdepth=-1)
+    {
+      double middle=this->bitdepth_2_norm(bitdepth-1)+1;
+      this->reallocate(cimg.width,cimg.height);
+      this->import_planes(cimg,cimg.spectrum,[&](color_type &pixel,const DefaultTypes::int_type *const *planes,std::size_t i)
+      {
+        double average=0;
+        for(int c=0;c<cimg.spectrum;c++) average+=planes[c][i];
+        if(cimg.spectrum>0) average/=(double)cimg.spectrum;
+        pixel=average>=middle;
+      });
+      if(this->verbose>=Verbose::Normal) std::cerr << compose_message(Message::Note,"ImageSegmentation::load","Black&white segmentation loaded correctly from "+filename) << "\n";
+    }
+    ///@see load(const typename std::enable_if<1<NN,std::string>::type &filename)
+    template <int NN=N> void import_cimg(const __PrivateCImgWrapper<DefaultTypes::int_type> &cimg,const typename std::enable_if<1<NN,std::string>::type &filename)
+    {
+      this->reallocate(cimg.width,cimg.height);
+      this->import_planes(cimg,N,[&](color_type &pixel,const DefaultTypes::int_type *const *planes,std::size_t i)
+      {
+        for(int c=0;c<N;c++) pixel[c]=planes[c]!=nullptr?planes[c][i]:0;
+      });
+      if(this->verbose>=Verbose::Normal) std::cerr << compose_message(Message::Note,
+                                                                      "ImageSegmentation::load",
+                                                                      std::to_string(N)+
+                                                                      " channel image loaded correctly from "+filename) << "\n";
+    }
+    ///@see load(const typename std::enable_if<!(NN==DefaultTypes::SegmentationN || NN==DefaultTypes::SegmentationBlackWhiteN || 1<NN),std::string>::type &filename,bool averageIfRGB,int bitdepth)
+    template <int NN=N> 
+    void import_cimg(const __PrivateCImgWrapper<DefaultTypes::int_type> &cimg,
+                     const typename std::enable_if<!(NN==DefaultTypes::SegmentationN || NN==DefaultTypes::SegmentationBlackWhiteN || 1<NN),std::string>::type &filename,
+                     bool averageIfRGB=false,int bitdepth=-1)
+    {
+      this->reallocate(cimg.width,cimg.height);
+      if(N==3 && !averageIfRGB)
+      {
+        this->import_planes(cimg,3,[&](color_type &pixel,const DefaultTypes::int_type *const *planes,std::size_t i)
+        {
+          pixel=(double)planes[0][i]*0.2989+(double)planes[1][i]*0.5871+(double)planes[2][i]*0.1140;
+        });
+      }
+      else
+      {
+        this->import_planes(cimg,cimg.spectrum,[&](color_type &pixel,const DefaultTypes::int_type *const *planes,std::size_t i)
+        {
+          T average=0;
+          for(int c=0;c<cimg.spectrum;c++) average+=planes[c][i];
+          if(cimg.spectrum>0) average/=(T)cimg.spectrum;
+          pixel=average;
+        });
+      }
+      if(std::is_floating_point<T>::value)
+      {
+        double norm=this->bitdepth_2_norm(bitdepth);
+        for(std::size_t i=0;i<this->numof_pixels();i++) this->buffer[i]/=norm;
+      }
+      if(this->verbose>=Verbose::Normal) 
+      {
+        std::string typeName="";
+        if(std::is_integral<T>::value) typeName=" integral ";
+        if(std::is_floating_point<T>::value) typeName=" floating point ";
+        std::cerr << compose_message(Message::Note,"ImageSegmentation::load","1 channel"+typeName+"image loaded correctly from "+filename) << "\n";
+      }
+    }
     //-------------------------------------------------------------------------
     public:
     /** Load binary (black&white) segmentation from file.
@@ -1209,14 +2703,8 @@ namespace LibImageSegmentation
     template <int NN=N> void load(const typename std::enable_if<NN==DefaultTypes::SegmentationBlackWhiteN,std::string>::type &filename,int bitdepth=-1)
     {
       static_assert(NN==N,"Error [ImageSegmentation::load]: Cannot change the number of channels.");
-      int x,y;
-      double middle=this->bitdepth_2_norm(bitdepth-1)+1;
       __PrivateCImgWrapper<DefaultTypes::int_type> cimg(filename);
-      this->reallocate(cimg.width,cimg.height);
-      for(x=0;x<this->width;x++)
-        for(y=0;y<this->height;y++)
-          this->data[x][y]=cimg.get_average(x,y)>=middle;
-      if(this->verbose>=Verbose::Normal) std::cerr << compose_message(Message::Note,"ImageSegmentation::load","Black&white segmentation loaded correctly from "+filename) << "\n";
+      this->import_cimg(cimg,filename,bitdepth);
     }
     //-------------------------------------------------------------------------
     /** Load multichannel image.
@@ -1232,16 +2720,8 @@ namespace LibImageSegmentation
     template <int NN=N> void load(const typename std::enable_if<1<NN,std::string>::type &filename)
     {
       static_assert(NN==N,"Error [ImageSegmentation::load]: Cannot change the number of channels.");
-      int x,y;
       __PrivateCImgWrapper<DefaultTypes::int_type> cimg(filename);
-      this->reallocate(cimg.width,cimg.height);
-      for(x=0;x<this->width;x++)
-        for(y=0;y<this->height;y++)
-          cimg.get(x,y,this->data[x][y]);
-      if(this->verbose>=Verbose::Normal) std::cerr << compose_message(Message::Note,
-                                                                      "ImageSegmentation::load",
-                                                                      std::to_string(N)+
-                                                                      " channel image loaded correctly from "+filename) << "\n";
+      this->import_cimg(cimg,filename);
     }
     //-------------------------------------------------------------------------
     /** Load a single channel image from file.
@@ -1256,148 +2736,82 @@ namespace LibImageSegmentation
     void load(const typename std::enable_if<!(NN==DefaultTypes::SegmentationN || NN==DefaultTypes::SegmentationBlackWhiteN || 1<NN),std::string>::type &filename,bool averageIfRGB=false,int bitdepth=-1)
     {
       static_assert(NN==N,"Error [ImageSegmentation::load]: Cannot change the number of channels.");
-      auto average=[](const std::vector<int> &color)->T
-      {
-        T ret=0;
-        for(auto &&it: color){ret+=it;}
-        if(color.size()>0)ret/=(T)color.size();
-        return(ret);
-      };
-      int x,y;
       __PrivateCImgWrapper<DefaultTypes::int_type> cimg(filename);
-      this->reallocate(cimg.width,cimg.height);
-      std::vector<int> color;
-      
-      if(N==3 && !averageIfRGB)
-      {
-        for(x=0;x<this->width;x++)
-        {
-          for(y=0;y<this->height;y++)
-          {
-            cimg.get(x,y,color);
-            this->data[x][y]=(double)color[0]*0.2989+(double)color[1]*0.5871+(double)color[2]*0.1140;
-          }
-        }
-      }
-      else
-      {
-        for(x=0;x<this->width;x++)
-        {
-          for(y=0;y<this->height;y++)
-          {
-            cimg.get(x,y,color);
-            this->data[x][y]=average(color);
-          }
-        }
-      }
-      if(std::is_floating_point<T>::value)
-      {
-        double norm=this->bitdepth_2_norm(bitdepth);
-        for(x=0;x<this->width;x++)
-          for(y=0;y<this->height;y++)
-            this->data[x][y]/=norm;
-      }
-      if(this->verbose>=Verbose::Normal) 
-      {
-        std::string typeName="";
-        if(std::is_integral<T>::value) typeName=" integral ";
-        if(std::is_floating_point<T>::value) typeName=" floating point ";
-        std::cerr << compose_message(Message::Note,"ImageSegmentation::load","1 channel"+typeName+"image loaded correctly from "+filename) << "\n";
-      }
-
-    }
-    protected:
-    //-------------------------------------------------------------------------
-    int count_nonwhite_characters(const std::string &str)const
-    {
-      int res=0;
-      for(auto &&ch: str)
-        if(ch>(char)32) 
-          res++;
-      return(res);
+      this->import_cimg(cimg,filename,averageIfRGB,bitdepth);
     }
-    template <class TT=T> T atot(const typename std::enable_if<std::is_integral<TT>::value,std::string>::type &str)const{return(atoi(str.c_str()));}
-    template <class TT=T> T atot(const typename std::enable_if<std::is_floating_point<TT>::value,std::string>::type &str)const{return(atof(str.c_str()));}
-    template <class TT=T> T atot(const typename std::enable_if<!(std::is_integral<TT>::value ||  std::is_floating_point<TT>::value),std::string>::type &str)const {return(T(str));}
-    public:
     //-------------------------------------------------------------------------
     /** Load CSV file
      *  This function is defined only for segmentations and single channel images.
+     *  The file is memory mapped and read in a single pass. Large files are parsed by several threads, each thread parses
+     *  a block of whole lines into its own list of items, and the lists are copied into the image when the numbers of
+     *  rows of the blocks are known (each list is released as soon as it is copied).
+     *  @param numofThreads Number of threads, values <=0 mean the number of hardware threads.
+     *  @throw CoreException if the file does not exist.
+     *  @throw BadCSVFormatException if the file contains no data, the rows have different number of items
+     *                               or there is a blank line and _ignoreBlankLines_ is false.
      */
     template <int NN=N> 
-    void load_csv(const typename std::enable_if<NN<=1,std::string>::type &filename,char delimiter=',',bool ignoreBlankLines=true)
+    void load_csv(const typename std::enable_if<NN<=1,std::string>::type &filename,char delimiter=',',bool ignoreBlankLines=true,int numofThreads=0)
     {
       static_assert(NN==N,"Error [ImageSegmentation::load_csv]: Cannot change the number of channels.");
-      std::string line,item;
-      int lineNum=0;
-      std::ifstream in(filename);
-      int height=0,width=-1;
-      std::vector<int> nonwhite;
-      bool ret=true;
-      if(in.good()) 
-      {
-        while(in.good())
-        {
-          std::getline (in, line);
-          std::stringstream ss(line);
-
-          nonwhite.clear();
-          lineNum++;
-          while(std::getline(ss, item, delimiter)) nonwhite.push_back(this->count_nonwhite_characters(item));
-          if((nonwhite.size()==1 && nonwhite[0]==0) || (nonwhite.size()==0 && in.good())) //blank line
-          {
-            if(ignoreBlankLines) nonwhite.clear();
-            else 
-            {
-              throw(BadCSVFormatException(compose_message(Message::Error,
-                                                          "ImageSegmentation::load_csv",
-                                                          "File " + filename + ", line " + std::to_string(lineNum) + " is blank.")));
-            }
-          }
-          
-          if(width==-1 && nonwhite.size()>0) width=nonwhite.size();
-          if(nonwhite.size()>0 && (int)nonwhite.size()!=width)
-          {
-            throw(BadCSVFormatException(compose_message(Message::Error,
-                                                        "ImageSegmentation::load_csv",
-                                                        "File " + filename + ", line " + std::to_string(lineNum) + 
-                                                        " has different number of items than previous lines ("+
-                                                        std::to_string(nonwhite.size()) + "!=" + std::to_string(height)+").")));
-          } 
-          if(nonwhite.size()>0) height++;
-        }
-        if(width<0) width=0;
-        if(width==0 || height==0)
+      std::unique_ptr<MappedFile> file;
+      {
+        std::ifstream in(filename,std::ios::binary|std::ios::ate);
+        if(!in.good()) throw(CoreException(compose_message(Message::Error,"ImageSegmentation::load_csv","File not found: "+filename)));
+        if(in.tellg()>0) file.reset(new MappedFile(filename,MappedFile::Access::ReadOnly));
+      }
+      auto chunks=split_csv_chunks(file?file->data():nullptr,file?file->size():0,resolve_numof_threads(numofThreads));
+      std::vector<CsvChunk<T> > parts(chunks.size());
+      parallel_for((int)chunks.size(),numofThreads,[&](int i)
+      {
+        parse_csv_chunk(chunks[i].first,chunks[i].second,delimiter,ignoreBlankLines,parts[i]);
+      });
+      file.reset();
+      int width=-1,height=0,lineNum=0;
+      for(auto &&part: parts)
+      {
+        if(width==-1) width=part.width;
+        bool differentFirstRow=part.numofRows>0 && part.width!=width;
+        if(part.error==CsvChunk<T>::Error::BlankLine && (!differentFirstRow || part.errorLine<part.firstRowLine))
         {
           throw(BadCSVFormatException(compose_message(Message::Error,
                                                       "ImageSegmentation::load_csv",
-                                                      "File " + filename + " contains no csv data.")));
+                                                      "File " + filename + ", line " + std::to_string(lineNum+part.errorLine) + " is blank.")));
         }
-        int currX=0,currY=0;
-        if(ret)
+        if(differentFirstRow || part.error==CsvChunk<T>::Error::DifferentWidth)
         {
-          this->reallocate(width,height);
-          in.close();
-          in.open(filename);
-          while(in.good())
-          {
-            std::getline (in, line);
-            std::stringstream ss(line);
-            currX=0;
-            while (std::getline(ss, item, delimiter))
-            {
-              this->data[currX][currY]=this->atot<T>(item);
-              currX++;
-            }
-            if(currX==this->width) currY++;
-          }
+          throw(BadCSVFormatException(compose_message(Message::Error,
+                                                      "ImageSegmentation::load_csv",
+                                                      "File " + filename + ", line " + 
+                                                      std::to_string(lineNum+(differentFirstRow?part.firstRowLine:part.errorLine)) + 
+                                                      " has different number of items than previous lines ("+
+                                                      std::to_string(differentFirstRow?part.width:part.errorWidth) + "!=" + 
+                                                      std::to_string(height+(differentFirstRow?0:part.numofRows))+").")));
         }
-        in.close();
+        height+=part.numofRows;
+        lineNum+=part.numofLines;
       }
-      else
+      if(width<=0 || height==0)
       {
-        throw(CoreException(compose_message(Message::Error,"ImageSegmentation::load_csv","File not found: "+filename)));
+        throw(BadCSVFormatException(compose_message(Message::Error,
+                                                    "ImageSegmentation::load_csv",
+                                                    "File " + filename + " contains no csv data.")));
       }
+      this->reallocate(width,height);
+      std::vector<int> firstRows(parts.size(),0);
+      for(std::size_t i=1;i<parts.size();i++) firstRows[i]=firstRows[i-1]+parts[i-1].numofRows;
+      parallel_for((int)parts.size(),numofThreads,[&](int i)
+      {
+        std::vector<T> &values=parts[i].values;
+        for(int row=0;row<parts[i].numofRows;row++)
+        {
+          const T *src=values.data()+(std::size_t)row*width;
+          int y=firstRows[i]+row;
+          if(Layout::rowMajor) std::copy(src,src+width,this->buffer+Layout::offset(0,y,this->stride));
+          else for(int x=0;x<width;x++) this->buffer[Layout::offset(x,y,this->stride)]=src[x];
+        }
+        std::vector<T>().swap(values);
+      });
     }
     //-------------------------------------------------------------------------
     /*
@@ -1424,47 +2838,13 @@ namespace LibImageSegmentation
     */
     
     
-    protected:
-
-    //-------------------------------------------------------------------------
-    template <class U,int NN=N> void _save_raw(const typename std::enable_if<1<NN,std::string>::type &filename,double scale,double m)const
-    {
-      __PrivateCImgWrapper<U> cimg(this->width,this->height,this->spectrum);
-      int x,y,c;
-      for(c=0;c<this->spectrum;c++)
-        for(x=0;x<this->width;x++)
-          for(y=0;y<this->height;y++)
-            cimg.set(x,y,c,(U)(m*this->data[x][y][c]));
-      cimg.resize(scale);
-      cimg.save(filename);
-    }
-    //-------------------------------------------------------------------------
-    template <class U,int NN=N> void _save_raw(const typename std::enable_if<!(1<NN),std::string>::type &filename,double scale,double m)const
-    {
-      __PrivateCImgWrapper<U> cimg(this->width,this->height,this->spectrum);
-      int x,y;
-      for(x=0;x<this->width;x++)
-        for(y=0;y<this->height;y++)
-          cimg.set(x,y,0,(U)(m*this->data[x][y]));
-      cimg.resize(scale);
-      cimg.save(filename);
-    }
-       
     public:
     //-------------------------------------------------------------------------
     /** Save segmentation/image into a file as-is.
      */
     void save_raw(const std::string &filename,double scale=1,int desiredBitdepth=-1)const
     {
-      double m=1;
-      if(std::is_floating_point<T>::value) m=this->bitdepth_2_norm(desiredBitdepth);
-      if(desiredBitdepth==8) this->_save_raw<uint8_t>(filename,scale,m);
-      else if(desiredBitdepth==16) this->_save_raw<uint16_t>(filename,scale,m);
-      else if(desiredBitdepth==32) this->_save_raw<uint32_t>(filename,scale,m);
-      else if(desiredBitdepth==64) this->_save_raw<uint64_t>(filename,scale,m);
-      else if(std::is_floating_point<T>::value) this->_save_raw<DefaultTypes::float_type>(filename,scale,m);
-      else if(std::is_unsigned<T>::value) this->_save_raw<DefaultTypes::uint_type>(filename,scale,m);
-      else this->_save_raw<DefaultTypes::int_type>(filename,scale,m);
+      this->view().save_raw(filename,scale,desiredBitdepth);
     }
     //-------------------------------------------------------------------------
     /** Save binary segmentation into a file.
@@ -1482,12 +2862,7 @@ namespace LibImageSegmentation
      */    
     void save_bw(const std::string &filename,const color_type &foregroundColor)const
     {
-      __PrivateCImgWrapper<DefaultTypes::int_type> cimg(this->width,this->height,1);
-      int x,y;
-      for(x=0;x<this->width;x++)
-        for(y=0;y<this->height;y++)
-          cimg.set(x,y,0,255*(this->data[x][y]==foregroundColor));
-      cimg.save(filename);
+      this->view().save_bw(filename,foregroundColor);
     }
     //-------------------------------------------------------------------------
     /** Save segmentation into a file using the standard palette.
@@ -1506,17 +2881,7 @@ namespace LibImageSegmentation
     void save_segmentation(const typename std::enable_if<NN<=1,std::string>::type &filename,
                            const Palette<PT,PN> &palette)const
     {
-      __PrivateCImgWrapper<DefaultTypes::int_type> cimg(this->width,this->height,palette.spectrum);
-      int x,y;
-      for(x=0;x<this->width;x++)
-      {
-        for(y=0;y<this->height;y++)
-        {
-          auto &&color=palette.get_color_for_segmentation(this->data[x][y]);
-          for(int c=0;c<palette.spectrum;c++) cimg.set(x,y,c,color[c]);
-        }
-      }
-      cimg.save(filename);
+      this->view().save_segmentation(filename,palette);
     }    
     //-------------------------------------------------------------------------
     /** Save segmentation into a file using the standard palette.
@@ -1560,28 +2925,23 @@ namespace LibImageSegmentation
     //-------------------------------------------------------------------------
     /** Save this segmentation/image into a text csv file.
      */
-    void save_csv(const std::string &filename,char delimiter=',')const    
+    void save_csv(const std::string &filename,char delimiter=',',int numofThreads=0)const    
     {
-      std::ofstream of(filename);
-      if(of.is_open())
-      {
-        int x,y;
-        for(y=0;y<this->height;y++)
-        {
-          for(x=0;x<this->width;x++)
-          {
-            of << this->data[x][y];
-            if(x<this->width-1) of << delimiter;
-          }
-          of << "\n";
-        }
-      }
-      of.close();
+      this->view().save_csv(filename,delimiter,numofThreads);
     }
   };
+//-----------------------------------------------------------------------------
+  /** Exchange the data of two segmentations/images.
+   *  @see ImageSegmentation::swap
+   */
+  template <class T,int N,class Layout> void swap(ImageSegmentation<T,N,Layout> &img1,ImageSegmentation<T,N,Layout> &img2) noexcept {img1.swap(img2);}
 //-----------------------------------------------------------------------------
   ///Typename for multilabel segmentation.
   using Segmentation=ImageSegmentation<DefaultTypes::int_type,DefaultTypes::SegmentationN>;
+  ///Typename for multilabel segmentation with at most 255 labels (label 255 marks unrecognized colors).
+  using Segmentation8=ImageSegmentation<uint8_t,DefaultTypes::SegmentationN>;
+  ///Typename for multilabel segmentation with at most 65535 labels (label 65535 marks unrecognized colors).
+  using Segmentation16=ImageSegmentation<uint16_t,DefaultTypes::SegmentationN>;
   ///Typename for binary segmentation.
   using SegmentationBW=ImageSegmentation<DefaultTypes::int_type,DefaultTypes::SegmentationBlackWhiteN>;
   ///Typename for RGB image.
@@ -1590,6 +2950,60 @@ namespace LibImageSegmentation
   using RGBImage=ImageRGB;
   ///Typename for one channel image.
   template <class T> using Image=ImageSegmentation<T,1>;
+//-----------------------------------------------------------------------------
+  ///Underlying types of multilabel segmentations.
+  enum class LabelType{UInt8,UInt16,Int};
+  /** Return the narrowest label type, which can hold labels 0,...,_maxLabel_ 
+   *  and Palette::colorNotRecognized at the same time.
+   */
+  inline LabelType narrowest_label_type(int maxLabel)
+  {
+    if(maxLabel<(int)std::numeric_limits<uint8_t>::max()) return(LabelType::UInt8);
+    if(maxLabel<(int)std::numeric_limits<uint16_t>::max()) return(LabelType::UInt16);
+    return(LabelType::Int);
+  }
+  /** Return the narrowest label type, which can hold indices of all colors in _palette_.
+   */
+  template <class PT,std::size_t PN> LabelType narrowest_label_type(const Palette<PT,PN> &palette){return(narrowest_label_type((int)palette.size()-1));}
+  /** Load multilabel segmentation using the narrowest label type for _palette_ (Segmentation8, Segmentation16 or Segmentation).
+   *  The label type is chosen from the number of colors in _palette_. Labels of 1 channel files, which do not fit into 
+   *  the chosen type, are set to Palette::colorNotRecognized.
+   *  @param filename Path to the loaded file.
+   *  @param palette Palette of the segmentation.
+   *  @param f A callable, which is called with the loaded segmentation. It must accept Segmentation8&, Segmentation16& 
+   *           and Segmentation&, e.g. a functor with a template operator().
+   *  @param verbose Verbosity.
+   *  @return Label type of the loaded segmentation.
+   */
+  template <class PT,std::size_t PN,class F> 
+  LabelType load_narrowest_segmentation(const std::string &filename,const Palette<PT,PN> &palette,F &&f,Verbose verbose=Verbose::Normal)
+  {
+    LabelType type=narrowest_label_type(palette);
+    if(type==LabelType::UInt8)
+    {
+      Segmentation8 seg(filename,palette,verbose);
+      f(seg);
+    }
+    else if(type==LabelType::UInt16)
+    {
+      Segmentation16 seg(filename,palette,verbose);
+      f(seg);
+    }
+    else
+    {
+      Segmentation seg(filename,palette,verbose);
+      f(seg);
+    }
+    return(type);
+  }
+  /** Load multilabel segmentation using the narrowest label type for the standard palette.
+   *  @see load_narrowest_segmentation(const std::string &filename,const Palette<PT,PN> &palette,F &&f,Verbose verbose)
+   */
+  template <class F> LabelType load_narrowest_segmentation(const std::string &filename,F &&f,Verbose verbose=Verbose::Normal)
+  {
+    StandardPalette sp;
+    return(load_narrowest_segmentation(filename,sp,std::forward<F>(f),verbose));
+  }
 //-----------------------------------------------------------------------------
   /** Load MNIST dataset (segmentations) from file 
    *  @param imagesFilename Path to the file with images. If _imagesFilename_=="", the images are not loaded.
@@ -1598,26 +3012,94 @@ namespace LibImageSegmentation
    *  @param resLabels std::vector with loaded class labels.
    *  @param threshold A threshold between background and foreground.
    *  @param indices Indices of segmentations and/or labels to be loaded.
+   *  @param numofThreads Number of threads decoding the images, values <=0 mean the number of hardware threads.
+   *  The files are memory mapped, so only the selected samples are read.
+   *  Defined for underlying types DefaultTypes::int_type, uint8_t and uint16_t.
    */  
-  template <int N> void load_mnist(const std::string &imagesFilename,
-                                   const std::string &labelsFilename,
-                                   std::vector<ImageSegmentation<DefaultTypes::int_type,N> > &resImages,
-                                   std::vector<int> &resLabels,
-                                   int threshold,
-                                   std::vector<int> *indices=nullptr);
+  template <int N,class T> void load_mnist(const std::string &imagesFilename,
+                                           const std::string &labelsFilename,
+                                           std::vector<ImageSegmentation<T,N> > &resImages,
+                                           std::vector<int> &resLabels,
+                                           int threshold,
+                                           std::vector<int> *indices=nullptr,
+                                           int numofThreads=0);
   /** Load MNIST dataset (single channel images) from file.
    *  @param imagesFilename Path to the file with images. If _imagesFilename_=="", the images are not loaded.
    *  @param labelsFilename Path to the file with class labels. If _labelsFilename_=="", the class labels are not loaded.
    *  @param resImages std::vector with loaded images.
    *  @param resLabels std::vector with loaded class labels.
    *  @param indices Indices of images and/or labels to be loaded.
+   *  @param numofThreads Number of threads decoding the images, values <=0 mean the number of hardware threads.
+   *  Defined for underlying types DefaultTypes::int_type, uint8_t and uint16_t.
    */  
-  void load_mnist(const std::string &imagesFilename,
-                  const std::string &labelsFilename,
-                  std::vector<Image<DefaultTypes::int_type> > &resImages,
-                  std::vector<int> &resLabels,
-                  std::vector<int> *indices=nullptr);
-
+  template <class T> void load_mnist(const std::string &imagesFilename,
+                                     const std::string &labelsFilename,
+                                     std::vector<Image<T> > &resImages,
+                                     std::vector<int> &resLabels,
+                                     std::vector<int> *indices=nullptr,
+                                     int numofThreads=0);
+//-----------------------------------------------------------------------------
+  /** File which could not be loaded by load_batch.
+   */
+  struct BatchLoadError
+  {
+    ///Position of the file in the list.
+    int index;
+    ///Name of the file.
+    std::string filename;
+    ///Message of the exception thrown while loading the file.
+    std::string message;
+  };
+  /** Load segmentations/images from files _filenames_ on _numofThreads_ threads and pass them to _f_ in the order of the list.
+   *  The files are decoded in parallel, but at most _queueSize_ loaded images wait for _f_, so the memory is bounded.
+   *  A file which cannot be loaded does not stop the loading, it is reported in the result and _f_ is not called for it.
+   *  @tparam I Type of the images, e.g. Segmentation or ImageRGB. The files are loaded by I::load(filename).
+   *  @param f A callable with arguments (int index,I &img), it is called in the calling thread and may take over _img_ by std::move.
+   *  @param numofThreads Number of threads, values <=0 mean the number of hardware threads.
+   *  @param queueSize Maximum number of loaded images waiting for _f_, values <=0 mean 2*_numofThreads_.
+   *  @param verbose Verbosity of the loaded images.
+   *  @return The files which could not be loaded in the order of the list.
+   */
+  template <class I,class F> std::vector<BatchLoadError> load_batch_each(const std::vector<std::string> &filenames,F f,int numofThreads=0,
+                                                                         int queueSize=0,Verbose verbose=Verbose::Silent)
+  {
+    struct Loaded
+    {
+      I img;
+      bool ok;
+      std::string message;
+    };
+    std::vector<BatchLoadError> ret;
+    parallel_ordered((int)filenames.size(),numofThreads,queueSize,[&](int i)
+    {
+      Loaded res{I(verbose),false,""};
+      try
+      {
+        res.img.load(filenames[i]);
+        res.ok=true;
+      }
+      catch(const std::exception &e){res.message=e.what();}
+      catch(...){res.message="Unknown error.";}
+      return(res);
+    },
+    [&](int i,Loaded &&res)
+    {
+      if(res.ok) f(i,res.img);
+      else ret.push_back(BatchLoadError{i,filenames[i],res.message});
+    });
+    return(ret);
+  }
+  /** Load segmentations/images from files _filenames_ on _numofThreads_ threads.
+   *  @param res Loaded images in the order of _filenames_, the images which could not be loaded are empty.
+   *  @see load_batch_each
+   */
+  template <class I> std::vector<BatchLoadError> load_batch(const std::vector<std::string> &filenames,std::vector<I> &res,int numofThreads=0,
+                                                            Verbose verbose=Verbose::Silent)
+  {
+    res.clear();
+    res.resize(filenames.size());
+    return(load_batch_each<I>(filenames,[&](int i,I &img){res[i]=std::move(img);},numofThreads,0,verbose));
+  }
 }
 #endif
 
@@ -0,0 +1,112 @@
+#ifndef LIB_IMAGE_SEGMENTATION_LAYOUT_H
+#define LIB_IMAGE_SEGMENTATION_LAYOUT_H
+#include <cstddef>
+namespace LibImageSegmentation
+{
+  /** Accessor of a column-major block of pixels, which does not need a table of column pointers.
+   *  ColumnMajorAccessor\[x\] is a pointer to the x-th column.
+   */
+  template <class C> class ColumnMajorAccessor
+  {
+    C *buffer=nullptr;
+    int stride=0;
+    public:
+    ColumnMajorAccessor(){}
+    ColumnMajorAccessor(C *buffer,int stride) : buffer(buffer),stride(stride){}
+    C* operator[](int x)const{return(this->buffer+(std::size_t)x*this->stride);}
+  };
+  //-----------------------------------------------------------------------------
+  /** Memory layout policy which stores the columns of an image one after another.
+   *  Pixel \[_x_,_y_\] is stored at buffer\[_x_*stride+_y_\] and ImageSegmentation::data is a table of column pointers.
+   *  This is the default layout and it is compatible with code that treats ImageSegmentation::data as color_type**.
+   */
+  struct ColumnMajor
+  {
+    ///True if the rows (not the columns) are stored contiguously.
+    static const bool rowMajor=false;
+    ///Type of ImageSegmentation::data.
+    template <class C> using accessor_type=C**;
+    ///Type of ImageView::data.
+    template <class C> using view_accessor_type=ColumnMajorAccessor<C>;
+    ///Number of elements between the beginnings of two consecutive columns.
+    static int stride(int,int height){return(height);}
+    ///Position of pixel \[_x_,_y_\] in the buffer.
+    static std::size_t offset(int x,int y,int stride){return((std::size_t)x*stride+y);}
+    ///Build the column table of _buffer_.
+    template <class C> static void attach(C **&data,C *buffer,int width,int height)
+    {
+      data=new C*[width];
+      for(int x=0;x<width;x++) data[x]=buffer+offset(x,0,height);
+    }
+    ///Release the column table.
+    template <class C> static void detach(C **&data){delete []data;data=nullptr;}
+    /** Visit all pixels of rectangle \[_x1_,_y1_\]-\[_x2_,_y2_\] in the order in which they are stored in memory.
+     *  @param f A callable with arguments (int x,int y).
+     */
+    template <class F> static void traverse(int x1,int y1,int x2,int y2,F f)
+    {
+      for(int x=x1;x<=x2;x++)
+        for(int y=y1;y<=y2;y++)
+          f(x,y);
+    }
+  };
+  //-----------------------------------------------------------------------------
+  /** One column of a row-major image.
+   *  This is the result of RowMajorAccessor::operator[] and it allows to use the data\[x\]\[y\] syntax.
+   */
+  template <class C> class StridedLine
+  {
+    C *first;
+    std::ptrdiff_t step;
+    public:
+    StridedLine(C *first,std::ptrdiff_t step) : first(first),step(step){}
+    C& operator[](int i)const{return(this->first[i*this->step]);}
+  };
+  /** Accessor of a row-major image.
+   *  RowMajorAccessor\[x\]\[y\] refers to the same pixel as data\[x\]\[y\] of a column-major image.
+   */
+  template <class C> class RowMajorAccessor
+  {
+    C *buffer=nullptr;
+    int stride=0;
+    public:
+    RowMajorAccessor(){}
+    RowMajorAccessor(C *buffer,int stride) : buffer(buffer),stride(stride){}
+    StridedLine<C> operator[](int x)const{return(StridedLine<C>(this->buffer+x,this->stride));}
+    ///Pointer to the first pixel of row _y_.
+    C* row(int y)const{return(this->buffer+(std::size_t)y*this->stride);}
+    bool operator==(std::nullptr_t)const{return(this->buffer==nullptr);}
+    bool operator!=(std::nullptr_t)const{return(this->buffer!=nullptr);}
+  };
+  /** Memory layout policy which stores the rows of an image one after another.
+   *  Pixel \[_x_,_y_\] is stored at buffer\[_y_*stride+_x_\]. This is the layout of all supported file formats
+   *  (PNG/TIFF scanlines, CSV rows, MNIST), so loading and saving do not need to transpose the data.
+   */
+  struct RowMajor
+  {
+    ///True if the rows (not the columns) are stored contiguously.
+    static const bool rowMajor=true;
+    ///Type of ImageSegmentation::data.
+    template <class C> using accessor_type=RowMajorAccessor<C>;
+    ///Type of ImageView::data.
+    template <class C> using view_accessor_type=RowMajorAccessor<C>;
+    ///Number of elements between the beginnings of two consecutive rows.
+    static int stride(int width,int){return(width);}
+    ///Position of pixel \[_x_,_y_\] in the buffer.
+    static std::size_t offset(int x,int y,int stride){return((std::size_t)y*stride+x);}
+    ///Build the accessor of _buffer_.
+    template <class C> static void attach(RowMajorAccessor<C> &data,C *buffer,int width,int){data=RowMajorAccessor<C>(buffer,width);}
+    ///Reset the accessor.
+    template <class C> static void detach(RowMajorAccessor<C> &data){data=RowMajorAccessor<C>();}
+    /** Visit all pixels of rectangle \[_x1_,_y1_\]-\[_x2_,_y2_\] in the order in which they are stored in memory.
+     *  @param f A callable with arguments (int x,int y).
+     */
+    template <class F> static void traverse(int x1,int y1,int x2,int y2,F f)
+    {
+      for(int y=y1;y<=y2;y++)
+        for(int x=x1;x<=x2;x++)
+          f(x,y);
+    }
+  };
+}
+#endif
@@ -0,0 +1,171 @@
+#include "ImageSegmentation.h"
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+LibImageSegmentation::MappedFile::MappedFile(const std::string &filename,Access access) : access(access)
+{
+  this->fd=open(filename.c_str(),access==Access::ReadOnly?O_RDONLY:O_RDWR);
+  if(this->fd<0) throw(CoreException("Error: [MappedFile::MappedFile]: Cannot open "+filename+": "+std::strerror(errno)));
+  struct stat st;
+  if(fstat(this->fd,&st)!=0)
+  {
+    close(this->fd);
+    throw(CoreException("Error: [MappedFile::MappedFile]: Cannot read size of "+filename+": "+std::strerror(errno)));
+  }
+  this->length=st.st_size;
+  this->map(filename);
+}
+//-----------------------------------------------------------------------------
+LibImageSegmentation::MappedFile::MappedFile(const std::string &filename,std::size_t length)
+{
+  this->fd=open(filename.c_str(),O_RDWR|O_CREAT|O_TRUNC,0644);
+  if(this->fd<0) throw(CoreException("Error: [MappedFile::MappedFile]: Cannot create "+filename+": "+std::strerror(errno)));
+  if(ftruncate(this->fd,length)!=0)
+  {
+    close(this->fd);
+    throw(CoreException("Error: [MappedFile::MappedFile]: Cannot resize "+filename+" to "+std::to_string(length)+" bytes: "+std::strerror(errno)));
+  }
+  this->length=length;
+  this->map(filename);
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::MappedFile::map(const std::string &filename)
+{
+  if(this->length==0)
+  {
+    close(this->fd);
+    throw(CoreException("Error: [MappedFile::map]: Cannot map empty file "+filename+"."));
+  }
+  int protection=this->access==Access::ReadOnly?PROT_READ:PROT_READ|PROT_WRITE;
+  void *addr=mmap(nullptr,this->length,protection,MAP_SHARED,this->fd,0);
+  if(addr==MAP_FAILED)
+  {
+    close(this->fd);
+    throw(CoreException("Error: [MappedFile::map]: Cannot map "+filename+": "+std::strerror(errno)));
+  }
+  this->address=(char*)addr;
+}
+//-----------------------------------------------------------------------------
+LibImageSegmentation::MappedFile::~MappedFile()
+{
+  if(this->address!=nullptr)
+  {
+    this->sync();
+    munmap(this->address,this->length);
+  }
+  if(this->fd>=0) close(this->fd);
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::MappedFile::sync(bool wait)const
+{
+  if(this->address!=nullptr && this->access==Access::ReadWrite) msync(this->address,this->length,wait?MS_SYNC:MS_ASYNC);
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::rle_encode(const char *src,std::size_t numofPixels,std::size_t pixelSize,std::vector<char> &dst)
+{
+  dst.clear();
+  std::size_t i=0;
+  while(i<numofPixels)
+  {
+    std::size_t j=i+1;
+    while(j<numofPixels && j-i<UINT32_MAX && std::memcmp(src+i*pixelSize,src+j*pixelSize,pixelSize)==0) j++;
+    uint32_t run=j-i;
+    dst.insert(dst.end(),(const char*)&run,(const char*)&run+sizeof(run));
+    dst.insert(dst.end(),src+i*pixelSize,src+(i+1)*pixelSize);
+    i=j;
+  }
+}
+//-----------------------------------------------------------------------------
+bool LibImageSegmentation::rle_decode(const char *src,std::size_t srcSize,char *dst,std::size_t numofPixels,std::size_t pixelSize)
+{
+  std::size_t pos=0,out=0;
+  while(pos<srcSize)
+  {
+    uint32_t run;
+    if(pos+sizeof(run)+pixelSize>srcSize) return(false);
+    std::memcpy(&run,src+pos,sizeof(run));
+    pos+=sizeof(run);
+    if(run==0 || out+run>numofPixels) return(false);
+    for(uint32_t k=0;k<run;k++,out++) std::memcpy(dst+out*pixelSize,src+pos,pixelSize);
+    pos+=pixelSize;
+  }
+  return(out==numofPixels);
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::write_native_pixels(std::ostream &out,const char *src,std::size_t numofPixels,std::size_t pixelSize,NativeCompression compression)
+{
+  if(compression==NativeCompression::None)
+  {
+    out.write(src,numofPixels*pixelSize);
+    return;
+  }
+  std::vector<char> encoded;
+  for(std::size_t first=0;first<numofPixels;first+=nativeBlockPixels)
+  {
+    std::size_t n=std::min(nativeBlockPixels,numofPixels-first);
+    rle_encode(src+first*pixelSize,n,pixelSize,encoded);
+    uint32_t mode=1;
+    uint64_t size=encoded.size();
+    const char *block=encoded.data();
+    if(size>=n*pixelSize)
+    {
+      mode=0;
+      size=n*pixelSize;
+      block=src+first*pixelSize;
+    }
+    out.write((const char*)&mode,sizeof(mode));
+    out.write((const char*)&size,sizeof(size));
+    out.write(block,size);
+  }
+}
+//-----------------------------------------------------------------------------
+bool LibImageSegmentation::read_native_pixels(std::istream &in,char *dst,std::size_t numofPixels,std::size_t pixelSize,NativeCompression compression)
+{
+  if(compression==NativeCompression::None)
+  {
+    in.read(dst,numofPixels*pixelSize);
+    return((std::size_t)in.gcount()==numofPixels*pixelSize);
+  }
+  std::vector<char> encoded;
+  for(std::size_t first=0;first<numofPixels;first+=nativeBlockPixels)
+  {
+    std::size_t n=std::min(nativeBlockPixels,numofPixels-first);
+    uint32_t mode;
+    uint64_t size;
+    in.read((char*)&mode,sizeof(mode));
+    in.read((char*)&size,sizeof(size));
+    if(!in.good() || mode>1 || (mode==0 && size!=n*pixelSize) || (mode==1 && size>n*(pixelSize+sizeof(uint32_t)))) return(false);
+    if(mode==0) in.read(dst+first*pixelSize,size);
+    else
+    {
+      encoded.resize(size);
+      in.read(encoded.data(),size);
+    }
+    if((uint64_t)in.gcount()!=size) return(false);
+    if(mode==1 && !rle_decode(encoded.data(),size,dst+first*pixelSize,n,pixelSize)) return(false);
+  }
+  return(true);
+}
+//-----------------------------------------------------------------------------
+bool LibImageSegmentation::skip_native_pixels(std::istream &in,std::size_t numofPixels,std::size_t pixelSize,NativeCompression compression)
+{
+  if(compression==NativeCompression::None) return((bool)in.seekg((std::streamoff)(numofPixels*pixelSize),std::ios::cur));
+  for(std::size_t first=0;first<numofPixels;first+=nativeBlockPixels)
+  {
+    std::size_t n=std::min(nativeBlockPixels,numofPixels-first);
+    uint32_t mode;
+    uint64_t size;
+    in.read((char*)&mode,sizeof(mode));
+    in.read((char*)&size,sizeof(size));
+    if(!in.good() || mode>1 || (mode==0 && size!=n*pixelSize) || (mode==1 && size>n*(pixelSize+sizeof(uint32_t)))) return(false);
+    if(!in.seekg((std::streamoff)size,std::ios::cur)) return(false);
+  }
+  return(true);
+}
@@ -0,0 +1,142 @@
+#ifndef LIB_IMAGE_SEGMENTATION_MAPPED_FILE_H
+#define LIB_IMAGE_SEGMENTATION_MAPPED_FILE_H
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <type_traits>
+#include <vector>
+namespace LibImageSegmentation
+{
+  ///Compression of the pixels in the native format.
+  enum class NativeCompression{None=0,RLE=1};
+  /** Header of the native image format.
+   *  The header (64 bytes) is followed by the contiguous block of all pixels in the memory layout of the image
+   *  and in the native byte order, so the pixels can be used directly from a memory mapped file.
+   */
+  struct NativeHeader
+  {
+    ///File signature.
+    char magic[8]={'L','I','S','N','A','T','V','\0'};
+    ///Version of the format.
+    uint32_t version=1;
+    ///Underlying type of the image, 256*kind+size in bytes, where kind is 0 (signed), 1 (unsigned) or 2 (floating point).
+    uint32_t typeCode=0;
+    ///Template parameter N of the image (number of channels or DefaultTypes::SegmentationN/SegmentationBlackWhiteN).
+    int32_t channels=0;
+    ///Width (number of columns).
+    int32_t width=0;
+    ///Height (number of rows).
+    int32_t height=0;
+    ///1 if the image has RowMajor layout, 0 for ColumnMajor.
+    int32_t rowMajor=0;
+    ///Size of one pixel in bytes.
+    uint64_t pixelSize=0;
+    ///Width of one tile of a tiled image, 0 if the image is not tiled.
+    int32_t tileWidth=0;
+    ///Height of one tile of a tiled image, 0 if the image is not tiled.
+    int32_t tileHeight=0;
+    ///Compression of the pixels (NativeCompression), only uncompressed files can be memory mapped.
+    uint32_t compression=0;
+    char reserved[12]={};
+    ///Code of the underlying type _T_.
+    template <class T> static uint32_t type_code()
+    {
+      return(256*(std::is_floating_point<T>::value?2:(std::is_unsigned<T>::value?1:0))+sizeof(T));
+    }
+    ///Header of an image of size \[_width_,_height_\] with underlying type _T_, _N_ channels and pixels of type _C_.
+    template <class T,int N,class C> static NativeHeader create(int width,int height,bool rowMajor,int tileWidth=0,int tileHeight=0,
+                                                                NativeCompression compression=NativeCompression::None)
+    {
+      NativeHeader ret;
+      ret.typeCode=type_code<T>();
+      ret.channels=N;
+      ret.width=width;
+      ret.height=height;
+      ret.rowMajor=rowMajor;
+      ret.pixelSize=sizeof(C);
+      ret.tileWidth=tileWidth;
+      ret.tileHeight=tileHeight;
+      ret.compression=(uint32_t)compression;
+      return(ret);
+    }
+    ///Size of the pixel block in bytes.
+    std::size_t data_size()const{return((std::size_t)this->width*this->height*this->pixelSize);}
+    ///Determines, whether this header and _header2_ describe images of the same type (the dimensions may differ).
+    bool is_compatible(const NativeHeader &header2)const
+    {
+      return(std::string(this->magic,8)==std::string(header2.magic,8) && this->version==header2.version &&
+             this->typeCode==header2.typeCode && this->channels==header2.channels &&
+             this->rowMajor==header2.rowMajor && this->pixelSize==header2.pixelSize &&
+             this->tileWidth==header2.tileWidth && this->tileHeight==header2.tileHeight &&
+             this->compression==header2.compression);
+    }
+  };
+  static_assert(sizeof(NativeHeader)==64,"Error [NativeHeader]: Unexpected size of the header.");
+  /** Run-length encoding of _numofPixels_ pixels of _pixelSize_ bytes.
+   *  Each run is stored as its length (uint32_t) followed by the bytes of the repeated pixel.
+   *  @param dst The encoded data (the previous content is discarded).
+   */
+  void rle_encode(const char *src,std::size_t numofPixels,std::size_t pixelSize,std::vector<char> &dst);
+  /** Decode _srcSize_ bytes of run-length encoded pixels into _dst_.
+   *  @return False if _src_ is damaged or does not contain exactly _numofPixels_ pixels.
+   */
+  bool rle_decode(const char *src,std::size_t srcSize,char *dst,std::size_t numofPixels,std::size_t pixelSize);
+  ///Number of pixels in one compressed block of the native format.
+  const std::size_t nativeBlockPixels=65536;
+  /** Write _numofPixels_ pixels of _pixelSize_ bytes in the native format.
+   *  Compressed pixels are split into independent blocks, each block is stored as its mode (uint32_t, 0 raw, 1 RLE),
+   *  its size in bytes (uint64_t) and its data. Blocks, which do not become smaller by compression, are stored raw.
+   */
+  void write_native_pixels(std::ostream &out,const char *src,std::size_t numofPixels,std::size_t pixelSize,NativeCompression compression);
+  /** Read _numofPixels_ pixels of _pixelSize_ bytes in the native format.
+   *  Uncompressed pixels are read by a single read.
+   *  @return False if the data are damaged or incomplete.
+   */
+  bool read_native_pixels(std::istream &in,char *dst,std::size_t numofPixels,std::size_t pixelSize,NativeCompression compression);
+  /** Skip _numofPixels_ pixels of _pixelSize_ bytes in the native format without decoding them.
+   *  Compressed pixels are skipped by whole blocks, so _numofPixels_ must be a multiple of nativeBlockPixels or reach the end of the data.
+   *  @return False if the data are damaged or incomplete.
+   */
+  bool skip_native_pixels(std::istream &in,std::size_t numofPixels,std::size_t pixelSize,NativeCompression compression);
+  //-----------------------------------------------------------------------------
+  /** Read-write memory mapping of a whole file.
+   *  The pages of the file are loaded on demand by the operating system, so the file may be larger than the memory.
+   */
+  class MappedFile
+  {
+    public:
+    ///Access to the mapped file.
+    enum class Access{ReadWrite,ReadOnly};
+    protected:
+    int fd=-1;
+    char *address=nullptr;
+    std::size_t length=0;
+    Access access=Access::ReadWrite;
+    public:
+    /** Map an existing file _filename_.
+     *  The pages of a ReadOnly mapping must not be written.
+     *  @throw CoreException if the file cannot be opened or mapped.
+     */
+    MappedFile(const std::string &filename,Access access=Access::ReadWrite);
+    /** Create (or overwrite) file _filename_ of _length_ bytes filled by zeros and map it.
+     *  @throw CoreException if the file cannot be created or mapped.
+     */
+    MappedFile(const std::string &filename,std::size_t length);
+    MappedFile(const MappedFile&)=delete;
+    MappedFile& operator=(const MappedFile&)=delete;
+    ///Write the changes back to the file and unmap it.
+    ~MappedFile();
+    ///First byte of the mapping.
+    char* data()const{return(this->address);}
+    ///Length of the mapping in bytes.
+    std::size_t size()const{return(this->length);}
+    /** Write the changes back to the file (msync).
+     *  @param wait If true, the method waits until the data are written, otherwise it only schedules the writing.
+     */
+    void sync(bool wait=true)const;
+    protected:
+    void map(const std::string &filename);
+  };
+}
+#endif
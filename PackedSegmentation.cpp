@@ -0,0 +1,259 @@
+#include "PackedSegmentation.h"
+#include <algorithm>
+
+namespace
+{
+  inline int popcount(LibImageSegmentation::PackedSegmentationBW::word_type w)
+  {
+    #if defined(__GNUC__)
+    return(__builtin_popcountll(w));
+    #else
+    int ret=0;
+    for(;w!=0;w&=w-1) ret++;
+    return(ret);
+    #endif
+  }
+  inline LibImageSegmentation::PackedSegmentationBW::word_type low_bits(std::size_t n)
+  {
+    using word_type=LibImageSegmentation::PackedSegmentationBW::word_type;
+    return(n>=(std::size_t)LibImageSegmentation::PackedSegmentationBW::wordBits?~(word_type)0:(((word_type)1<<n)-1));
+  }
+}
+//-----------------------------------------------------------------------------
+LibImageSegmentation::PackedSegmentationBW& LibImageSegmentation::PackedSegmentationBW::operator=(const PackedSegmentationBW &img2)
+{
+  if(this!=&img2)
+  {
+    this->release();
+    this->verbose=img2.verbose;
+    this->copy_data(img2);
+  }
+  return(*this);
+}
+//-----------------------------------------------------------------------------
+LibImageSegmentation::PackedSegmentationBW& LibImageSegmentation::PackedSegmentationBW::operator=(PackedSegmentationBW &&img2) noexcept
+{
+  if(this!=&img2)
+  {
+    this->release();
+    this->swap(img2);
+  }
+  return(*this);
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::PackedSegmentationBW::swap(PackedSegmentationBW &img2) noexcept
+{
+  std::swap(this->verbose,img2.verbose);
+  std::swap(this->width,img2.width);
+  std::swap(this->height,img2.height);
+  std::swap(this->stride,img2.stride);
+  std::swap(this->words,img2.words);
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::PackedSegmentationBW::reallocate(int width,int height)
+{
+  this->release();
+  if(width>0 && height>0)
+  {
+    this->width=width;
+    this->height=height;
+    this->stride=(width+wordBits-1)/wordBits;
+    this->words=new word_type[(std::size_t)this->stride*this->height]();
+  }
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::PackedSegmentationBW::release()
+{
+  delete []this->words;
+  this->words=nullptr;
+  this->width=0;
+  this->height=0;
+  this->stride=0;
+}
+//-----------------------------------------------------------------------------
+LibImageSegmentation::PackedSegmentationBW::word_type LibImageSegmentation::PackedSegmentationBW::last_word_mask()const
+{
+  return(low_bits(this->width-(std::size_t)(this->stride-1)*wordBits));
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::PackedSegmentationBW::fill_bits(word_type *dst,std::size_t dstBit,std::size_t n,bool value)
+{
+  while(n>0)
+  {
+    std::size_t w=dstBit/wordBits;
+    std::size_t offset=dstBit%wordBits;
+    std::size_t k=std::min<std::size_t>(n,wordBits-offset);
+    word_type mask=low_bits(k)<<offset;
+    dst[w]=value?(dst[w]|mask):(dst[w]&~mask);
+    dstBit+=k;
+    n-=k;
+  }
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::PackedSegmentationBW::copy_bits(const word_type *src,std::size_t srcBit,word_type *dst,std::size_t dstBit,std::size_t n)
+{
+  while(n>0)
+  {
+    std::size_t dw=dstBit/wordBits;
+    std::size_t dOffset=dstBit%wordBits;
+    std::size_t k=std::min<std::size_t>(n,wordBits-dOffset);
+    std::size_t sw=srcBit/wordBits;
+    std::size_t sOffset=srcBit%wordBits;
+    word_type bits=src[sw]>>sOffset;
+    if(sOffset>0 && sOffset+k>(std::size_t)wordBits) bits|=src[sw+1]<<(wordBits-sOffset);
+    word_type mask=low_bits(k);
+    dst[dw]=(dst[dw]&~(mask<<dOffset))|((bits&mask)<<dOffset);
+    srcBit+=k;
+    dstBit+=k;
+    n-=k;
+  }
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::PackedSegmentationBW::init_data(bool color,int x1,int y1,int x2,int y2)
+{
+  if(x1<0) x1=0;
+  if(y1<0) y1=0;
+  if(x2<0) x2=this->width-1;
+  if(y2<0) y2=this->height-1;
+  if(x2<x1 || y2<y1) return;
+  if(x1==0 && y1==0 && x2==this->width-1 && y2==this->height-1)
+  {
+    std::fill(this->words,this->words+(std::size_t)this->stride*this->height,color?~(word_type)0:0);
+    if(color)
+      for(int y=0;y<this->height;y++)
+        this->row(y)[this->stride-1]&=this->last_word_mask();
+  }
+  else
+  {
+    for(int y=y1;y<=y2;y++) fill_bits(this->row(y),x1,x2-x1+1,color);
+  }
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::PackedSegmentationBW::copy_data(const PackedSegmentationBW &img2,int targetX,int targetY)
+{
+  if(this->width<img2.width+targetX || this->height<img2.height+targetY) this->reallocate(img2.width,img2.height);
+  int leftX=std::max(0,-targetX);
+  int topY=std::max(0,-targetY);
+  if(leftX>=img2.width || topY>=img2.height) return;
+  if(targetX==0 && targetY==0 && img2.width==this->width && img2.height==this->height)
+  {
+    std::copy(img2.words,img2.words+(std::size_t)img2.stride*img2.height,this->words);
+  }
+  else
+  {
+    for(int y=topY;y<img2.height;y++)
+      copy_bits(img2.row(y),leftX,this->row(y+targetY),leftX+targetX,img2.width-leftX);
+  }
+}
+//-----------------------------------------------------------------------------
+int LibImageSegmentation::PackedSegmentationBW::count_label(bool l)const
+{
+  int ones=0;
+  for(std::size_t i=0;i<(std::size_t)this->stride*this->height;i++) ones+=popcount(this->words[i]);
+  return(l?ones:this->width*this->height-ones);
+}
+//-----------------------------------------------------------------------------
+LibImageSegmentation::PackedSegmentationBW& LibImageSegmentation::PackedSegmentationBW::operator&=(const PackedSegmentationBW &img2)
+{
+  if(this->width!=img2.width || this->height!=img2.height) throw(DimensionException("Error: [PackedSegmentationBW::operator&=]: Segmentations have different dimensions."));
+  for(std::size_t i=0;i<(std::size_t)this->stride*this->height;i++) this->words[i]&=img2.words[i];
+  return(*this);
+}
+//-----------------------------------------------------------------------------
+LibImageSegmentation::PackedSegmentationBW& LibImageSegmentation::PackedSegmentationBW::operator|=(const PackedSegmentationBW &img2)
+{
+  if(this->width!=img2.width || this->height!=img2.height) throw(DimensionException("Error: [PackedSegmentationBW::operator|=]: Segmentations have different dimensions."));
+  for(std::size_t i=0;i<(std::size_t)this->stride*this->height;i++) this->words[i]|=img2.words[i];
+  return(*this);
+}
+//-----------------------------------------------------------------------------
+LibImageSegmentation::PackedSegmentationBW& LibImageSegmentation::PackedSegmentationBW::operator^=(const PackedSegmentationBW &img2)
+{
+  if(this->width!=img2.width || this->height!=img2.height) throw(DimensionException("Error: [PackedSegmentationBW::operator^=]: Segmentations have different dimensions."));
+  for(std::size_t i=0;i<(std::size_t)this->stride*this->height;i++) this->words[i]^=img2.words[i];
+  return(*this);
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::PackedSegmentationBW::invert()
+{
+  word_type lastMask=this->last_word_mask();
+  for(int y=0;y<this->height;y++)
+  {
+    word_type *r=this->row(y);
+    for(int i=0;i<this->stride;i++) r[i]=~r[i];
+    r[this->stride-1]&=lastMask;
+  }
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::PackedSegmentationBW::load(const std::string &filename,int bitdepth)
+{
+  if(bitdepth<0) bitdepth+=9;
+  double middle=(1<<(bitdepth-1));
+  __PrivateCImgWrapper<DefaultTypes::int_type> cimg(filename);
+  this->reallocate(cimg.width,cimg.height);
+  //the average of the channels is compared with middle, i.e. their sum with middle*spectrum
+  double threshold=middle*std::max(cimg.spectrum,1);
+  std::vector<const DefaultTypes::int_type*> planes(cimg.spectrum);
+  for(int c=0;c<cimg.spectrum;c++) planes[c]=cimg.plane(c);
+  std::vector<double> sums(this->width);
+  for(int y=0;y<this->height;y++)
+  {
+    std::size_t first=(std::size_t)y*this->width;
+    std::fill(sums.begin(),sums.end(),0.0);
+    for(int c=0;c<cimg.spectrum;c++)
+    {
+      const DefaultTypes::int_type *src=planes[c]+first;
+      for(int x=0;x<this->width;x++) sums[x]+=src[x];
+    }
+    word_type *r=this->row(y);
+    for(int i=0;i<this->stride;i++)
+    {
+      word_type w=0;
+      int x0=i*wordBits;
+      int n=std::min(wordBits,this->width-x0);
+      for(int b=0;b<n;b++) w|=(word_type)(sums[x0+b]>=threshold)<<b;
+      r[i]=w;
+    }
+  }
+  if(this->verbose>=Verbose::Normal) std::cerr << "Note: [PackedSegmentationBW::load]: Black&white segmentation loaded correctly from " << filename << "\n";
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::PackedSegmentationBW::save(const std::string &filename)const
+{
+  __PrivateCImgWrapper<DefaultTypes::int_type> cimg(this->width,this->height,1);
+  DefaultTypes::int_type *plane=cimg.plane(0);
+  for(int y=0;y<this->height;y++)
+  {
+    const word_type *r=this->row(y);
+    DefaultTypes::int_type *dst=plane+(std::size_t)y*this->width;
+    for(int i=0;i<this->stride;i++)
+    {
+      word_type w=r[i];
+      int x0=i*wordBits;
+      int n=std::min(wordBits,this->width-x0);
+      for(int b=0;b<n;b++,w>>=1) dst[x0+b]=255*(DefaultTypes::int_type)(w&1);
+    }
+  }
+  cimg.save(filename);
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::PackedSegmentationBW::save_csv(const std::string &filename,char delimiter)const
+{
+  std::ofstream of(filename);
+  if(of.is_open())
+  {
+    std::string line;
+    for(int y=0;y<this->height;y++)
+    {
+      line.clear();
+      for(int x=0;x<this->width;x++)
+      {
+        line+=this->get_pixel(x,y)?'1':'0';
+        if(x<this->width-1) line+=delimiter;
+      }
+      line+='\n';
+      of << line;
+    }
+  }
+  of.close();
+}
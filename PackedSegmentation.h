@@ -0,0 +1,173 @@
+#ifndef LIB_IMAGE_SEGMENTATION_PACKED_SEGMENTATION_H
+#define LIB_IMAGE_SEGMENTATION_PACKED_SEGMENTATION_H
+#include <cstdint>
+#include "ImageSegmentation.h"
+namespace LibImageSegmentation
+{
+  /** Binary segmentation which stores one pixel in one bit.
+   *  The rows are stored one after another, each row occupies _stride_ 64-bit words and pixel \[_x_,_y_\]
+   *  is bit _x_%64 of word words\[_y_*stride+_x_/64\]. The unused bits at the end of each row are always 0,
+   *  so the bulk operations (initialization, copying, counting and logical operations) process whole words.
+   *  Compared to SegmentationBW it needs 32 times less memory.
+   */
+  class PackedSegmentationBW
+  {
+    public:
+    ///Type of one storage word.
+    using word_type=uint64_t;
+    ///Number of pixels in one storage word.
+    static const int wordBits=64;
+    ///Verbosity of image loading.
+    Verbose verbose=Verbose::Normal;
+    ///Width (number of columns).
+    int width=0;
+    ///Height (number of rows).
+    int height=0;
+    ///Number of words per row.
+    int stride=0;
+    ///Packed pixel data.
+    word_type *words=nullptr;
+    ///Dimensions \[width,height\].
+    Pixel<int> size()const{return(Pixel<int>(this->width,this->height));}
+    /** Constructor.
+     *  Creates an empty segmentation.
+     */
+    PackedSegmentationBW(Verbose verbose=Verbose::Normal){this->verbose=verbose;}
+    /** Constructor.
+     *  Creates a segmentation of size \[width,height\] filled by zeros.
+     */
+    PackedSegmentationBW(int width,int height,Verbose verbose=Verbose::Normal) : PackedSegmentationBW(verbose){this->reallocate(width,height);}
+    /** Constructor.
+     *  Loads a binary (black & white) segmentation from file.
+     *  @see load(const std::string &filename,int bitdepth)
+     */
+    PackedSegmentationBW(const std::string &filename,int bitdepth=-1,Verbose verbose=Verbose::Normal) : PackedSegmentationBW(verbose){this->load(filename,bitdepth);}
+    /** Constructor.
+     *  Packs a segmentation or a single channel image, nonzero pixels are foreground.
+     */
+    template <class T,int N,class Layout> explicit PackedSegmentationBW(const ImageSegmentation<T,N,Layout> &img) : PackedSegmentationBW(img.verbose){this->pack(img.view());}
+    ///Copy constructor.
+    PackedSegmentationBW(const PackedSegmentationBW &img2) : PackedSegmentationBW(img2.verbose){this->copy_data(img2);}
+    ///Move constructor.
+    PackedSegmentationBW(PackedSegmentationBW &&img2) noexcept : PackedSegmentationBW(img2.verbose){this->swap(img2);}
+    ///Assignment operator.
+    PackedSegmentationBW& operator=(const PackedSegmentationBW &img2);
+    ///Move assignment operator.
+    PackedSegmentationBW& operator=(PackedSegmentationBW &&img2) noexcept;
+    ~PackedSegmentationBW(){this->release();}
+    ///Exchange the data of this segmentation and _img2_.
+    void swap(PackedSegmentationBW &img2) noexcept;
+    //-------------------------------------------------------------------------
+    /** Reallocate the segmentation to size \[width,height\].
+     *  The old data are destroyed and all pixels are set to 0.
+     */
+    void reallocate(int width,int height);
+    /** Reallocate the segmentation to size \[size.x,size.y\].
+     */
+    void reallocate(const Pixel<int> &size){this->reallocate(size.x,size.y);}
+    /** Deallocate the data and set the dimensions to \[0,0\].
+     */
+    void release();
+    //-------------------------------------------------------------------------
+    /** Determines, whether pixel \[_x_,_y_\] is inside this segmentation.
+     */
+    bool is_pixel_inside(int x,int y)const{return(x>=0 && x<this->width && y>=0 && y<this->height);}
+    /** Value of pixel \[_x_,_y_\]. The pixel must lie inside the segmentation.
+     */
+    bool get_pixel(int x,int y)const{return((this->row(y)[x/wordBits]>>(x%wordBits))&1);}
+    /** Set value of pixel \[_x_,_y_\]. The pixel must lie inside the segmentation.
+     */
+    void set_pixel(int x,int y,bool value)
+    {
+      word_type &w=this->row(y)[x/wordBits];
+      word_type mask=(word_type)1<<(x%wordBits);
+      w=value?(w|mask):(w&~mask);
+    }
+    /** Value of pixel \[_x_,_y_\] or -1 if the pixel is outside the segmentation.
+     */
+    int get_pixel_safe(int x,int y)const{return(this->is_pixel_inside(x,y)?(int)this->get_pixel(x,y):-1);}
+    /** Set value of pixel \[_x_,_y_\].
+     *  @return True if \[_x_,_y_\] is inside the segmentation, false otherwise.
+     */
+    bool set_pixel_safe(int x,int y,bool value)
+    {
+      if(!this->is_pixel_inside(x,y)) return(false);
+      this->set_pixel(x,y,value);
+      return(true);
+    }
+    ///Pointer to the first word of row _y_.
+    word_type* row(int y){return(this->words+(std::size_t)y*this->stride);}
+    ///Pointer to the first word of row _y_.
+    const word_type* row(int y)const{return(this->words+(std::size_t)y*this->stride);}
+    //-------------------------------------------------------------------------
+    /** Init data to value _color_.
+     *  @see ImageSegmentation::init_data(const color_type &color,int x1,int y1,int x2,int y2)
+     */
+    void init_data(bool color,int x1=-1,int y1=-1,int x2=-1,int y2=-1);
+    /** Copy data of _img2_ to this segmentation.
+     *  @see ImageSegmentation::copy_data(const ImageSegmentation<T,N,Layout> &img2,int targetX,int targetY)
+     */
+    void copy_data(const PackedSegmentationBW &img2,int targetX=0,int targetY=0);
+    /** Return number of occurences of _l_ in the data.
+     */
+    int count_label(bool l)const;
+    //-------------------------------------------------------------------------
+    ///Pixel-wise AND, both segmentations must have the same dimensions.
+    PackedSegmentationBW& operator&=(const PackedSegmentationBW &img2);
+    ///Pixel-wise OR, both segmentations must have the same dimensions.
+    PackedSegmentationBW& operator|=(const PackedSegmentationBW &img2);
+    ///Pixel-wise XOR, both segmentations must have the same dimensions.
+    PackedSegmentationBW& operator^=(const PackedSegmentationBW &img2);
+    ///Pixel-wise NOT of this segmentation (in place).
+    void invert();
+    friend PackedSegmentationBW operator&(PackedSegmentationBW img1,const PackedSegmentationBW &img2){img1&=img2;return(img1);}
+    friend PackedSegmentationBW operator|(PackedSegmentationBW img1,const PackedSegmentationBW &img2){img1|=img2;return(img1);}
+    friend PackedSegmentationBW operator^(PackedSegmentationBW img1,const PackedSegmentationBW &img2){img1^=img2;return(img1);}
+    friend PackedSegmentationBW operator~(PackedSegmentationBW img1){img1.invert();return(img1);}
+    //-------------------------------------------------------------------------
+    /** Pack a segmentation or a single channel image, nonzero pixels are foreground.
+     */
+    template <class T,int N,class Layout> void pack(const ImageView<T,N,Layout> &img)
+    {
+      this->reallocate(img.width,img.height);
+      for(int y=0;y<this->height;y++)
+      {
+        word_type *r=this->row(y);
+        for(int x=0;x<this->width;x++)
+          if(img.data[x][y]!=0) r[x/wordBits]|=(word_type)1<<(x%wordBits);
+      }
+    }
+    /** Pack a segmentation or a single channel image, nonzero pixels are foreground.
+     */
+    template <class T,int N,class Layout> void pack(const ImageSegmentation<T,N,Layout> &img){this->pack(img.view());}
+    /** Unpack this segmentation into _res_, which is reallocated to the size of this segmentation.
+     */
+    template <class T,int N,class Layout> void unpack(ImageSegmentation<T,N,Layout> &res)const
+    {
+      res.reallocate(this->width,this->height);
+      res.traverse([&](int x,int y){res.data[x][y]=this->get_pixel(x,y);});
+    }
+    //-------------------------------------------------------------------------
+    /** Load binary (black&white) segmentation from file.
+     *  The pixels are packed directly while reading the file, no unpacked copy is created.
+     *  @see ImageSegmentation::load(const std::string &filename,int bitdepth)
+     */
+    void load(const std::string &filename,int bitdepth=-1);
+    /** Save binary segmentation into a file.
+     */
+    void save(const std::string &filename)const;
+    /** Save this segmentation into a text csv file.
+     */
+    void save_csv(const std::string &filename,char delimiter=',')const;
+    protected:
+    ///Mask of the used bits in the last word of each row.
+    word_type last_word_mask()const;
+    ///Set _n_ bits of _dst_ starting at bit _dstBit_ to _value_.
+    static void fill_bits(word_type *dst,std::size_t dstBit,std::size_t n,bool value);
+    ///Copy _n_ bits starting at bit _srcBit_ of _src_ to _dst_ starting at bit _dstBit_.
+    static void copy_bits(const word_type *src,std::size_t srcBit,word_type *dst,std::size_t dstBit,std::size_t n);
+  };
+  ///@see PackedSegmentationBW::swap
+  inline void swap(PackedSegmentationBW &img1,PackedSegmentationBW &img2) noexcept {img1.swap(img2);}
+}
+#endif
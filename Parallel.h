@@ -0,0 +1,138 @@
+#ifndef LIB_IMAGE_SEGMENTATION_PARALLEL_H
+#define LIB_IMAGE_SEGMENTATION_PARALLEL_H
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+namespace LibImageSegmentation
+{
+  /** Number of threads used when _numofThreads_ threads are requested.
+   *  @return The number of hardware threads if _numofThreads_<=0 (at least 1), _numofThreads_ otherwise.
+   */
+  inline int resolve_numof_threads(int numofThreads)
+  {
+    if(numofThreads>0) return(numofThreads);
+    return(std::max(1,(int)std::thread::hardware_concurrency()));
+  }
+  /** Call _f_(i) for all i from 0 to _n_-1 on at most _numofThreads_ threads.
+   *  The tasks are taken in increasing order of i, one thread runs in the calling thread. If some tasks throw an exception,
+   *  the remaining tasks are still finished and the exception of the task with the lowest i is rethrown.
+   *  @param numofThreads Number of threads, values <=0 mean the number of hardware threads.
+   */
+  template <class F> void parallel_for(int n,int numofThreads,F f)
+  {
+    numofThreads=std::min(resolve_numof_threads(numofThreads),n);
+    if(numofThreads<=1)
+    {
+      for(int i=0;i<n;i++) f(i);
+      return;
+    }
+    std::atomic<int> next(0);
+    std::vector<std::exception_ptr> errors(n);
+    auto worker=[&]()
+    {
+      for(int i=next++;i<n;i=next++)
+      {
+        try{f(i);}
+        catch(...){errors[i]=std::current_exception();}
+      }
+    };
+    std::vector<std::thread> threads;
+    for(int t=1;t<numofThreads;t++) threads.push_back(std::thread(worker));
+    worker();
+    for(auto &&it: threads) it.join();
+    for(auto &&it: errors) if(it) std::rethrow_exception(it);
+  }
+  /** Split tasks 0,...,_n_-1 into _numofRanges_ ranges of consecutive tasks, which differ in length by at most one, and call
+   *  _f_(t,begin,end) for range _t_=\[begin,end) on its own thread (t=0,...,_numofRanges_-1).
+   *  Unlike parallel_for, each thread gets a known index _t_, e.g. to select its working memory.
+   */
+  template <class F> void parallel_ranges(int n,int numofRanges,F f)
+  {
+    parallel_for(numofRanges,numofRanges,[&](int t)
+    {
+      f(t,(int)((long long)n*t/numofRanges),(int)((long long)n*(t+1)/numofRanges));
+    });
+  }
+  /** Compute _produce_(i) for all i from 0 to _n_-1 on at most _numofThreads_ worker threads and pass the results
+   *  to _consume_(i,result) in the calling thread in increasing order of i.
+   *  The queue of the tasks is bounded: task i is started only if i<c+_capacity_, where c is the number of consumed results,
+   *  so at most _capacity_ results exist at once even if _consume_ is slower than the workers. If _produce_ or _consume_
+   *  throws an exception, no new tasks are started and the exception is rethrown when all threads finish.
+   *  @param numofThreads Number of worker threads, values <=0 mean the number of hardware threads. If it is 1,
+   *                      all tasks run in the calling thread.
+   *  @param capacity Maximum number of results waiting for consumption, values <=0 mean 2*_numofThreads_.
+   *  @param consume A callable with arguments (int i,R &&result), where R is the type returned by _produce_.
+   */
+  template <class P,class C> void parallel_ordered(int n,int numofThreads,int capacity,P produce,C consume)
+  {
+    using result_type=typename std::decay<decltype(produce(0))>::type;
+    numofThreads=std::min(resolve_numof_threads(numofThreads),n);
+    if(numofThreads<=1)
+    {
+      for(int i=0;i<n;i++) consume(i,produce(i));
+      return;
+    }
+    if(capacity<=0) capacity=2*numofThreads;
+    std::vector<std::unique_ptr<result_type> > results(capacity);
+    std::vector<std::exception_ptr> errors(capacity);
+    std::vector<char> ready(capacity,0);
+    int next=0,consumed=0;
+    bool stop=false;
+    std::mutex mutex;
+    std::condition_variable slotFreed,resultReady;
+    auto worker=[&]()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while(true)
+      {
+        slotFreed.wait(lock,[&](){return(stop || next>=n || next<consumed+capacity);});
+        if(stop || next>=n) return;
+        int i=next++;
+        lock.unlock();
+        std::unique_ptr<result_type> result;
+        std::exception_ptr error;
+        try{result.reset(new result_type(produce(i)));}
+        catch(...){error=std::current_exception();}
+        lock.lock();
+        results[i%capacity]=std::move(result);
+        errors[i%capacity]=error;
+        ready[i%capacity]=1;
+        resultReady.notify_one();
+      }
+    };
+    std::vector<std::thread> threads;
+    for(int t=0;t<numofThreads;t++) threads.push_back(std::thread(worker));
+    std::exception_ptr error;
+    for(int i=0;i<n && !error;i++)
+    {
+      std::unique_ptr<result_type> result;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        resultReady.wait(lock,[&](){return(ready[i%capacity]!=0);});
+        result=std::move(results[i%capacity]);
+        error=errors[i%capacity];
+        errors[i%capacity]=nullptr;
+        ready[i%capacity]=0;
+        consumed=i+1;
+      }
+      slotFreed.notify_all();
+      if(error) break;
+      try{consume(i,std::move(*result));}
+      catch(...){error=std::current_exception();}
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop=true;
+    }
+    slotFreed.notify_all();
+    for(auto &&it: threads) it.join();
+    if(error) std::rethrow_exception(error);
+  }
+}
+#endif
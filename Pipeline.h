@@ -0,0 +1,233 @@
+#ifndef LIB_IMAGE_SEGMENTATION_PIPELINE_H
+#define LIB_IMAGE_SEGMENTATION_PIPELINE_H
+#include <deque>
+#include <functional>
+#include "ImageSegmentation.h"
+#include "Parallel.h"
+namespace LibImageSegmentation
+{
+  /** Asynchronous load-process-save loop over a list of files.
+   *  While the caller processes the current image, background threads load the next _prefetch_ images and another
+   *  thread saves the submitted results, so the I/O overlaps the computation. The images are returned in the order
+   *  of the list. Both queues are bounded: the loading stops when _prefetch_ images wait for next and save blocks
+   *  while _saveQueueSize_ images wait for saving. The images released by next and the saved images are kept in a pool
+   *  and reused for loading, images of the same size are loaded without reallocation of the pixels.
+   *  Example:
+   *  \code
+   *  ImagePipeline<ImageRGB> pipeline(filenames);
+   *  ImageRGB img;
+   *  while(pipeline.next(img))
+   *  {
+   *    img.resize(0.5);
+   *    pipeline.save(std::move(img),"small_"+std::to_string(pipeline.index())+".png");
+   *  }
+   *  pipeline.flush();
+   *  \endcode
+   * @tparam I Type of the images, e.g. Segmentation or ImageRGB.
+   */
+  template <class I> class ImagePipeline
+  {
+    public:
+    ///Function loading file (second argument) into an image.
+    using load_function=std::function<void(I&,const std::string&)>;
+    ///Function saving an image.
+    using save_function=std::function<void(const I&)>;
+    protected:
+    struct Slot
+    {
+      std::unique_ptr<I> img;
+      std::exception_ptr error;
+      bool ready=false;
+    };
+    struct SaveTask
+    {
+      std::unique_ptr<I> img;
+      save_function f;
+    };
+    std::vector<std::string> filenames;
+    load_function loader;
+    Verbose verbose;
+    int prefetch;
+    int saveQueueSize;
+    std::size_t poolSize;
+    std::vector<Slot> slots;
+    std::vector<std::unique_ptr<I> > pool;
+    std::deque<SaveTask> saveQueue;
+    bool saving=false;
+    std::exception_ptr saveError;
+    int nextLoad=0;
+    int consumed=0;
+    bool stop=false;
+    std::mutex mutex;
+    std::condition_variable slotFreed,slotReady,saveChanged;
+    std::vector<std::thread> loadThreads;
+    std::thread saveThread;
+    //-------------------------------------------------------------------------
+    std::unique_ptr<I> take_from_pool()
+    {
+      if(this->pool.empty()) return(std::unique_ptr<I>(new I(this->verbose)));
+      std::unique_ptr<I> ret=std::move(this->pool.back());
+      this->pool.pop_back();
+      return(ret);
+    }
+    void return_to_pool(std::unique_ptr<I> img)
+    {
+      if(img!=nullptr && img->width>0 && img->height>0 && this->pool.size()<this->poolSize) this->pool.push_back(std::move(img));
+    }
+    void load_worker()
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      while(true)
+      {
+        this->slotFreed.wait(lock,[&](){return(this->stop || this->nextLoad>=(int)this->filenames.size() || this->nextLoad<this->consumed+this->prefetch);});
+        if(this->stop || this->nextLoad>=(int)this->filenames.size()) return;
+        int i=this->nextLoad++;
+        std::unique_ptr<I> img=this->take_from_pool();
+        lock.unlock();
+        std::exception_ptr error;
+        try{this->loader(*img,this->filenames[i]);}
+        catch(...){error=std::current_exception();}
+        lock.lock();
+        Slot &slot=this->slots[i%this->prefetch];
+        if(error) this->return_to_pool(std::move(img));
+        else slot.img=std::move(img);
+        slot.error=error;
+        slot.ready=true;
+        this->slotReady.notify_all();
+      }
+    }
+    void save_worker()
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      while(true)
+      {
+        this->saveChanged.wait(lock,[&](){return(this->stop || !this->saveQueue.empty());});
+        if(this->saveQueue.empty()) return;
+        SaveTask task=std::move(this->saveQueue.front());
+        this->saveQueue.pop_front();
+        this->saving=true;
+        lock.unlock();
+        std::exception_ptr error;
+        try{task.f(*task.img);}
+        catch(...){error=std::current_exception();}
+        lock.lock();
+        if(error && !this->saveError) this->saveError=error;
+        this->return_to_pool(std::move(task.img));
+        this->saving=false;
+        this->saveChanged.notify_all();
+      }
+    }
+    void rethrow_save_error()
+    {
+      std::exception_ptr error;
+      std::swap(error,this->saveError);
+      if(error) std::rethrow_exception(error);
+    }
+    public:
+    /** Constructor.
+     *  Starts loading the images from files _filenames_ by I::load(filename).
+     *  @param prefetch Maximum number of loaded images waiting for next (at least 1).
+     *  @param numofThreads Number of loading threads, values <=0 mean the number of hardware threads.
+     *  @param saveQueueSize Maximum number of images waiting for saving (at least 1).
+     *  @param verbose Verbosity of the loaded images.
+     */
+    ImagePipeline(const std::vector<std::string> &filenames,int prefetch=2,int numofThreads=0,int saveQueueSize=2,Verbose verbose=Verbose::Silent) :
+      ImagePipeline(filenames,[](I &img,const std::string &filename){img.load(filename);},prefetch,numofThreads,saveQueueSize,verbose){}
+    /** Constructor.
+     *  Starts loading the images from files _filenames_ by _loader_, e.g. [](Image<float> &img,const std::string &f){img.load_csv(f);}.
+     *  @see ImagePipeline(const std::vector<std::string>&,int,int,int,Verbose)
+     */
+    ImagePipeline(const std::vector<std::string> &filenames,load_function loader,int prefetch=2,int numofThreads=0,int saveQueueSize=2,
+                  Verbose verbose=Verbose::Silent) : filenames(filenames),loader(std::move(loader)),verbose(verbose)
+    {
+      this->prefetch=std::max(1,prefetch);
+      this->saveQueueSize=std::max(1,saveQueueSize);
+      numofThreads=std::min(resolve_numof_threads(numofThreads),std::min(this->prefetch,(int)this->filenames.size()));
+      this->poolSize=(std::size_t)(this->prefetch+this->saveQueueSize+numofThreads+2);
+      this->slots.resize(this->prefetch);
+      for(int t=0;t<numofThreads;t++) this->loadThreads.push_back(std::thread(&ImagePipeline<I>::load_worker,this));
+      this->saveThread=std::thread(&ImagePipeline<I>::save_worker,this);
+    }
+    ImagePipeline(const ImagePipeline<I>&)=delete;
+    ImagePipeline<I>& operator=(const ImagePipeline<I>&)=delete;
+    /** Destructor.
+     *  Stops loading and waits until all submitted images are saved, errors of saving are ignored (see flush).
+     */
+    ~ImagePipeline()
+    {
+      {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stop=true;
+      }
+      this->slotFreed.notify_all();
+      this->saveChanged.notify_all();
+      for(auto &&it: this->loadThreads) it.join();
+      this->saveThread.join();
+    }
+    ///Number of files.
+    int size()const{return((int)this->filenames.size());}
+    ///Index (position in the list of files) of the image returned by the last call of next, -1 before the first call.
+    int index()const{return(this->consumed-1);}
+    /** Move the next image into _img_, the previous content of _img_ is reused for loading.
+     *  Blocks until the image is loaded.
+     *  @return False if all images were returned.
+     *  @throw The exception thrown while loading the image, the next call continues with the following file.
+     */
+    bool next(I &img)
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      if(this->consumed>=(int)this->filenames.size()) return(false);
+      Slot &slot=this->slots[this->consumed%this->prefetch];
+      this->slotReady.wait(lock,[&](){return(slot.ready);});
+      std::unique_ptr<I> loaded=std::move(slot.img);
+      std::exception_ptr error=slot.error;
+      slot.error=nullptr;
+      slot.ready=false;
+      this->consumed++;
+      this->slotFreed.notify_all();
+      if(error) std::rethrow_exception(error);
+      img.swap(*loaded);
+      this->return_to_pool(std::move(loaded));
+      return(true);
+    }
+    /** Save _img_ by _f_ in the background.
+     *  Blocks while the queue of images waiting for saving is full.
+     *  @throw The first exception thrown by a previous save which was not rethrown yet.
+     */
+    void submit(I &&img,save_function f)
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->rethrow_save_error();
+      this->saveChanged.wait(lock,[&](){return((int)this->saveQueue.size()<this->saveQueueSize);});
+      SaveTask task;
+      task.img.reset(new I(std::move(img)));
+      task.f=std::move(f);
+      this->saveQueue.push_back(std::move(task));
+      this->saveChanged.notify_all();
+    }
+    /** Save _img_ into file _filename_ in the background by I::save(filename).
+     *  @see submit
+     */
+    void save(I &&img,const std::string &filename)
+    {
+      this->submit(std::move(img),[filename](const I &image){image.save(filename);});
+    }
+    /** Save _img_ into CSV file _filename_ in the background by I::save_csv(filename,delimiter).
+     *  @see submit
+     */
+    void save_csv(I &&img,const std::string &filename,char delimiter=',')
+    {
+      this->submit(std::move(img),[filename,delimiter](const I &image){image.save_csv(filename,delimiter);});
+    }
+    /** Wait until all submitted images are saved.
+     *  @throw The first exception thrown by a save which was not rethrown yet.
+     */
+    void flush()
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->saveChanged.wait(lock,[&](){return(this->saveQueue.empty() && !this->saving);});
+      this->rethrow_save_error();
+    }
+  };
+}
+#endif
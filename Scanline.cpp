@@ -0,0 +1,745 @@
+#include "Scanline.h"
+#include <cerrno>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#ifdef cimg_use_png
+  #include <png.h>
+#endif
+#ifdef cimg_use_tiff
+  #include <tiffio.h>
+#endif
+namespace LibImageSegmentation
+{
+  /** Decoder of the formats without a streaming backend, the whole image is loaded by CImg.
+   */
+  class ScanlineCImgDecoder : public ScanlineDecoder
+  {
+    __PrivateCImgWrapper<DefaultTypes::float_type> *cimg=nullptr;
+    int nextRow=0;
+    public:
+    ScanlineCImgDecoder(const std::string &filename)
+    {
+      this->cimg=new __PrivateCImgWrapper<DefaultTypes::float_type>(filename);
+      this->width=this->cimg->width;
+      this->height=this->cimg->height;
+      this->spectrum=this->cimg->spectrum;
+      this->sampleFormat=SampleFormat::Float;
+      this->sampleBytes=sizeof(DefaultTypes::float_type);
+    }
+    ~ScanlineCImgDecoder(){delete this->cimg;}
+    void read_row(char *dst)
+    {
+      DefaultTypes::float_type *row=(DefaultTypes::float_type*)dst;
+      std::size_t offset=(std::size_t)this->nextRow*this->width;
+      for(int c=0;c<this->spectrum;c++)
+      {
+        const DefaultTypes::float_type *src=this->cimg->plane(c)+offset;
+        for(int x=0;x<this->width;x++) row[x*this->spectrum+c]=src[x];
+      }
+      this->nextRow++;
+    }
+  };
+  /** Encoder of the formats without a streaming backend, the whole image is saved by CImg in close().
+   */
+  class ScanlineCImgEncoder : public ScanlineEncoder
+  {
+    std::string filename;
+    __PrivateCImgWrapper<DefaultTypes::float_type> *cimg=nullptr;
+    std::vector<DefaultTypes::float_type> row;
+    int nextRow=0;
+    public:
+    ScanlineCImgEncoder(const std::string &filename,int width,int height,int spectrum) : filename(filename)
+    {
+      this->cimg=new __PrivateCImgWrapper<DefaultTypes::float_type>(width,height,spectrum);
+      this->row.resize((std::size_t)width*spectrum);
+    }
+    ~ScanlineCImgEncoder(){delete this->cimg;}
+    void write_row(const char *src)
+    {
+      convert_samples(src,this->sampleFormat,this->sampleBytes,this->row.data(),this->row.size());
+      std::size_t offset=(std::size_t)this->nextRow*this->width;
+      for(int c=0;c<this->spectrum;c++)
+      {
+        DefaultTypes::float_type *dst=this->cimg->plane(c)+offset;
+        for(int x=0;x<this->width;x++) dst[x]=this->row[x*this->spectrum+c];
+      }
+      this->nextRow++;
+    }
+    void close(){this->cimg->save(this->filename);}
+  };
+}
+using namespace LibImageSegmentation;
+namespace
+{
+  ///Lower case extension of _filename_ without the dot.
+  std::string extension(const std::string &filename)
+  {
+    std::size_t dot=filename.find_last_of('.');
+    if(dot==std::string::npos || filename.find('/',dot)!=std::string::npos) return("");
+    std::string ret=filename.substr(dot+1);
+    for(auto &&ch: ret) ch=(char)std::tolower((unsigned char)ch);
+    return(ret);
+  }
+  /** Copy pixels _x1_, _x1_+_step_, ... (at most _x2_) of _row_ to _dst_.
+   *  @return The end of the copied pixels in _dst_.
+   */
+  char* gather_pixels(const char *row,int x1,int x2,int step,std::size_t pixelSize,char *dst)
+  {
+    for(int x=x1;x<=x2;x+=step,dst+=pixelSize) std::memcpy(dst,row+x*pixelSize,pixelSize);
+    return(dst);
+  }
+  //---------------------------------------------------------------------------
+  /** Rows of a CSV file, the items are parsed by atoi (_V_=int) or by atof (_V_=double).
+   *  The constructor reads the file once to find its dimensions and to check its format.
+   */
+  template <class V> class CsvDecoder : public ScanlineDecoder
+  {
+    std::ifstream in;
+    std::string line;
+    CsvChunk<V> chunk;
+    char delimiter;
+    public:
+    CsvDecoder(const std::string &filename,char delimiter,bool ignoreBlankLines) : in(filename,std::ios::binary),delimiter(delimiter)
+    {
+      this->sampleFormat=std::is_floating_point<V>::value?SampleFormat::Float:SampleFormat::Int;
+      this->sampleBytes=sizeof(V);
+      this->spectrum=1;
+      if(!this->in.good()) throw(CoreException("Error: [ScanlineReader::ScanlineReader]: File not found: "+filename));
+      int width=-1,height=0,lineNum=0;
+      while(std::getline(this->in,this->line))
+      {
+        lineNum++;
+        int numofItems=count_csv_items(this->line.data(),this->line.data()+this->line.size(),delimiter);
+        if(numofItems<0)
+        {
+          if(ignoreBlankLines) continue;
+          throw(BadCSVFormatException("Error: [ScanlineReader::ScanlineReader]: File "+filename+", line "+std::to_string(lineNum)+" is blank."));
+        }
+        if(width<0) width=numofItems;
+        else if(numofItems!=width)
+        {
+          throw(BadCSVFormatException("Error: [ScanlineReader::ScanlineReader]: File "+filename+", line "+std::to_string(lineNum)+
+                                      " has different number of items than previous lines ("+std::to_string(numofItems)+"!="+
+                                      std::to_string(height)+")."));
+        }
+        height++;
+      }
+      if(width<=0 || height==0) throw(BadCSVFormatException("Error: [ScanlineReader::ScanlineReader]: File "+filename+" contains no csv data."));
+      this->width=width;
+      this->height=height;
+      this->in.clear();
+      this->in.seekg(0);
+    }
+    void read_row(char *dst)
+    {
+      while(std::getline(this->in,this->line))
+      {
+        this->chunk.values.clear();
+        this->chunk.numofRows=0;
+        this->chunk.width=-1;
+        parse_csv_chunk(this->line.data(),this->line.data()+this->line.size(),this->delimiter,true,this->chunk);
+        if(this->chunk.numofRows==0) continue;
+        if(this->chunk.width!=this->width) break;
+        std::memcpy(dst,this->chunk.values.data(),this->row_bytes());
+        return;
+      }
+      throw(BadCSVFormatException("Error: [ScanlineReader::read_rows]: The csv file has changed while reading."));
+    }
+  };
+  /** Writer of 1 channel CSV files in the same format as ImageView::save_csv.
+   */
+  class CsvEncoder : public ScanlineEncoder
+  {
+    std::ofstream out;
+    std::string filename;
+    std::string line;
+    char delimiter;
+    template <class V> void append_row(const char *src)
+    {
+      const V *values=(const V*)src;
+      for(int x=0;x<this->width;x++)
+      {
+        append_csv_item(this->line,values[x]);
+        if(x<this->width-1) this->line+=this->delimiter;
+      }
+    }
+    public:
+    CsvEncoder(const std::string &filename,char delimiter) : out(filename,std::ios::binary),filename(filename),delimiter(delimiter)
+    {
+      if(!this->out.is_open()) throw(CoreException("Error: [ScanlineWriter::ScanlineWriter]: Cannot create "+filename));
+    }
+    void write_row(const char *src)
+    {
+      this->line.clear();
+      if(this->sampleFormat==SampleFormat::Float)
+      {
+        if(this->sampleBytes==sizeof(float)) this->append_row<float>(src);
+        else if(this->sampleBytes==sizeof(double)) this->append_row<double>(src);
+        else this->append_row<long double>(src);
+      }
+      else if(this->sampleFormat==SampleFormat::Int)
+      {
+        if(this->sampleBytes==1) this->append_row<int8_t>(src);
+        else if(this->sampleBytes==2) this->append_row<int16_t>(src);
+        else if(this->sampleBytes==4) this->append_row<int32_t>(src);
+        else this->append_row<int64_t>(src);
+      }
+      else
+      {
+        if(this->sampleBytes==1) this->append_row<uint8_t>(src);
+        else if(this->sampleBytes==2) this->append_row<uint16_t>(src);
+        else if(this->sampleBytes==4) this->append_row<uint32_t>(src);
+        else this->append_row<uint64_t>(src);
+      }
+      this->line+='\n';
+      this->out.write(this->line.data(),this->line.size());
+    }
+    void close()
+    {
+      this->out.close();
+      if(this->out.fail()) throw(CoreException("Error: [ScanlineWriter::close]: Cannot write "+this->filename));
+    }
+  };
+  //---------------------------------------------------------------------------
+  /** Rows of a file in the native format (see NativeHeader).
+   *  Row-major files are read row by row (compressed files block by block), column-major files must be uncompressed
+   *  and are gathered from a read-only memory mapping.
+   */
+  class NativeDecoder : public ScanlineDecoder
+  {
+    std::ifstream in;
+    std::unique_ptr<MappedFile> file;
+    NativeHeader header;
+    std::vector<char> block;
+    std::size_t blockPos=0;
+    std::size_t remainingPixels=0;
+    int nextRow=0;
+    public:
+    NativeDecoder(const std::string &filename) : in(filename,std::ios::binary)
+    {
+      if(!this->in.good()) throw(CoreException("Error: [ScanlineReader::ScanlineReader]: File not found: "+filename));
+      this->in.read((char*)&this->header,sizeof(this->header));
+      int kind=this->header.typeCode/256;
+      this->sampleBytes=this->header.typeCode%256;
+      this->sampleFormat=kind==0?SampleFormat::Int:(kind==1?SampleFormat::UInt:SampleFormat::Float);
+      bool ok=this->in.gcount()==sizeof(this->header) && std::string(this->header.magic,8)==std::string(NativeHeader().magic,8) && this->header.version==NativeHeader().version &&
+              this->header.width>=0 && this->header.height>=0 && this->header.tileWidth==0 && this->header.tileHeight==0 &&
+              this->header.compression<=(uint32_t)NativeCompression::RLE && kind<=2 &&
+              (this->sampleBytes==1 || this->sampleBytes==2 || this->sampleBytes==4 || this->sampleBytes==8) &&
+              (kind<2 || this->sampleBytes>=4) && this->header.pixelSize>0 && this->header.pixelSize%this->sampleBytes==0;
+      if(!ok) throw(BadNativeFormatException("Error: [ScanlineReader::ScanlineReader]: "+filename+" does not contain a native image of a supported type."));
+      this->width=this->header.width;
+      this->height=this->header.height;
+      this->spectrum=this->header.pixelSize/this->sampleBytes;
+      this->remainingPixels=(std::size_t)this->width*this->height;
+      if(this->header.rowMajor==0)
+      {
+        if(this->header.compression!=(uint32_t)NativeCompression::None)
+          throw(BadNativeFormatException("Error: [ScanlineReader::ScanlineReader]: Compressed column-major file "+filename+" cannot be read by rows."));
+        this->in.close();
+        if(this->remainingPixels==0) return;
+        this->file.reset(new MappedFile(filename,MappedFile::Access::ReadOnly));
+        if(this->file->size()<sizeof(this->header)+this->header.data_size())
+          throw(BadNativeFormatException("Error: [ScanlineReader::ScanlineReader]: "+filename+" is damaged."));
+      }
+      else if(this->header.compression==(uint32_t)NativeCompression::None)
+      {
+        std::streampos pos=this->in.tellg();
+        this->in.seekg(0,std::ios::end);
+        std::streamoff remaining=this->in.tellg()-pos;
+        this->in.seekg(pos);
+        if(pos<0 || remaining<0 || (unsigned long long)remaining<this->header.data_size())
+          throw(BadNativeFormatException("Error: [ScanlineReader::ScanlineReader]: "+filename+" is damaged."));
+      }
+    }
+    void read_row(char *dst)
+    {
+      std::size_t pixelSize=this->header.pixelSize,rowBytes=this->row_bytes();
+      if(this->file)
+      {
+        const char *pixels=this->file->data()+sizeof(this->header);
+        for(int x=0;x<this->width;x++)
+          std::memcpy(dst+x*pixelSize,pixels+ColumnMajor::offset(x,this->nextRow,this->height)*pixelSize,pixelSize);
+      }
+      else if(this->header.compression==(uint32_t)NativeCompression::None)
+      {
+        this->in.read(dst,rowBytes);
+        if((std::size_t)this->in.gcount()!=rowBytes) throw(BadNativeFormatException("Error: [ScanlineReader::read_rows]: The native file is damaged."));
+      }
+      else
+      {
+        //Compressed blocks of read_native_pixels are independent, so they are decoded one at a time
+        for(std::size_t done=0;done<rowBytes;)
+        {
+          if(this->blockPos==this->block.size())
+          {
+            std::size_t n=std::min(this->remainingPixels,nativeBlockPixels);
+            this->block.resize(n*pixelSize);
+            this->blockPos=0;
+            if(n==0 || !read_native_pixels(this->in,this->block.data(),n,pixelSize,NativeCompression::RLE))
+              throw(BadNativeFormatException("Error: [ScanlineReader::read_rows]: The native file is damaged."));
+            this->remainingPixels-=n;
+          }
+          std::size_t n=std::min(rowBytes-done,this->block.size()-this->blockPos);
+          std::memcpy(dst+done,this->block.data()+this->blockPos,n);
+          this->blockPos+=n;
+          done+=n;
+        }
+      }
+      this->nextRow++;
+    }
+    void read_region(int x1,int y1,int x2,int y2,int step,char *dst)
+    {
+      std::size_t pixelSize=this->header.pixelSize;
+      if(this->file)
+      {
+        const char *pixels=this->file->data()+sizeof(this->header);
+        for(int y=y1;y<=y2;y+=step)
+          for(int x=x1;x<=x2;x+=step,dst+=pixelSize) std::memcpy(dst,pixels+ColumnMajor::offset(x,y,this->height)*pixelSize,pixelSize);
+      }
+      else if(this->header.compression==(uint32_t)NativeCompression::None)
+      {
+        std::vector<char> span((std::size_t)(x2-x1+1)*pixelSize);
+        for(int y=y1;y<=y2;y+=step)
+        {
+          this->in.seekg((std::streamoff)(sizeof(this->header)+((std::size_t)y*this->width+x1)*pixelSize));
+          this->in.read(span.data(),span.size());
+          if((std::size_t)this->in.gcount()!=span.size()) throw(BadNativeFormatException("Error: [ScanlineDecoder::read_region]: The native file is damaged."));
+          dst=gather_pixels(span.data(),0,x2-x1,step,pixelSize,dst);
+        }
+      }
+      else ScanlineDecoder::read_region(x1,y1,x2,y2,step,dst);
+    }
+  };
+  /** Writer of uncompressed row-major files in the native format.
+   */
+  class NativeEncoder : public ScanlineEncoder
+  {
+    std::ofstream out;
+    std::string filename;
+    public:
+    NativeEncoder(const std::string &filename,int width,int height,int spectrum,SampleFormat sampleFormat,int sampleBytes) :
+      out(filename,std::ios::binary),filename(filename)
+    {
+      if(!this->out.is_open()) throw(CoreException("Error: [ScanlineWriter::ScanlineWriter]: Cannot create "+filename));
+      NativeHeader header;
+      header.typeCode=256*(sampleFormat==SampleFormat::Int?0:(sampleFormat==SampleFormat::UInt?1:2))+sampleBytes;
+      header.channels=spectrum;
+      header.width=width;
+      header.height=height;
+      header.rowMajor=1;
+      header.pixelSize=(uint64_t)spectrum*sampleBytes;
+      this->out.write((const char*)&header,sizeof(header));
+    }
+    void write_row(const char *src){this->out.write(src,this->row_bytes());}
+    void close()
+    {
+      this->out.close();
+      if(this->out.fail()) throw(CoreException("Error: [ScanlineWriter::close]: Cannot write "+this->filename));
+    }
+  };
+  //---------------------------------------------------------------------------
+  /** Convert _n_ samples of an encoder to type _D_, the values are clamped to \[0,_maxValue_\].
+   *  @param tmp Buffer for the conversion.
+   */
+  template <class D> void clamp_samples(const ScanlineEncoder &encoder,const char *src,D *dst,std::size_t n,double maxValue,std::vector<double> &tmp)
+  {
+    tmp.resize(n);
+    convert_samples(src,encoder.sampleFormat,encoder.sampleBytes,tmp.data(),n);
+    for(std::size_t i=0;i<n;i++) dst[i]=(D)std::max(0.0,std::min(maxValue,tmp[i]));
+  }
+  #ifdef cimg_use_png
+  ///Determines, whether the platform is little endian (PNG and the native format store the samples in different byte orders).
+  bool little_endian()
+  {
+    uint16_t one=1;
+    return(*(const char*)&one==1);
+  }
+  /** Rows of a non-interlaced PNG file decoded by libpng.
+   *  Palettes and low bit depths are expanded to 8 bits, transparency to an alpha channel (the same as CImg does).
+   */
+  class PngDecoder : public ScanlineDecoder
+  {
+    std::FILE *file=nullptr;
+    png_structp png=nullptr;
+    png_infop info=nullptr;
+    public:
+    ///False if the file is interlaced, the rows have to be decoded by CImg.
+    bool streamable=false;
+    PngDecoder(const std::string &filename)
+    {
+      this->file=std::fopen(filename.c_str(),"rb");
+      if(this->file==nullptr) throw(CoreException("Error: [ScanlineReader::ScanlineReader]: File not found: "+filename));
+      this->png=png_create_read_struct(PNG_LIBPNG_VER_STRING,nullptr,nullptr,nullptr);
+      if(this->png!=nullptr) this->info=png_create_info_struct(this->png);
+      if(this->info==nullptr)
+      {
+        this->destroy();
+        throw(CoreException("Error: [ScanlineReader::ScanlineReader]: Cannot initialize libpng."));
+      }
+      if(setjmp(png_jmpbuf(this->png)))
+      {
+        this->destroy();
+        throw(CoreException("Error: [ScanlineReader::ScanlineReader]: "+filename+" is not a valid PNG file."));
+      }
+      png_init_io(this->png,this->file);
+      png_read_info(this->png,this->info);
+      if(png_get_interlace_type(this->png,this->info)!=PNG_INTERLACE_NONE) return;
+      png_set_expand(this->png);
+      if(png_get_bit_depth(this->png,this->info)==16 && little_endian()) png_set_swap(this->png);
+      png_read_update_info(this->png,this->info);
+      this->width=png_get_image_width(this->png,this->info);
+      this->height=png_get_image_height(this->png,this->info);
+      this->spectrum=png_get_channels(this->png,this->info);
+      this->sampleFormat=SampleFormat::UInt;
+      this->sampleBytes=png_get_bit_depth(this->png,this->info)/8;
+      this->streamable=png_get_rowbytes(this->png,this->info)==this->row_bytes();
+    }
+    ~PngDecoder(){this->destroy();}
+    ///Release libpng and close the file (the destructor is not called if the constructor throws).
+    void destroy()
+    {
+      if(this->png!=nullptr) png_destroy_read_struct(&this->png,this->info!=nullptr?&this->info:nullptr,nullptr);
+      if(this->file!=nullptr) std::fclose(this->file);
+      this->png=nullptr;
+      this->info=nullptr;
+      this->file=nullptr;
+    }
+    void read_row(char *dst)
+    {
+      if(setjmp(png_jmpbuf(this->png))) throw(CoreException("Error: [ScanlineReader::read_rows]: The PNG file is damaged."));
+      png_read_row(this->png,(png_bytep)dst,nullptr);
+    }
+  };
+  /** Writer of 8-bit (uint8_t samples) or 16-bit (other samples) PNG files with 1 to 4 channels.
+   */
+  class PngEncoder : public ScanlineEncoder
+  {
+    std::FILE *file=nullptr;
+    png_structp png=nullptr;
+    png_infop info=nullptr;
+    std::string filename;
+    std::vector<char> row;
+    std::vector<double> tmp;
+    bool eightBit;
+    public:
+    PngEncoder(const std::string &filename,int width,int height,int spectrum,SampleFormat sampleFormat,int sampleBytes) :
+      filename(filename),eightBit(sampleFormat==SampleFormat::UInt && sampleBytes==1)
+    {
+      if(spectrum<1 || spectrum>4) throw(DimensionException("Error: [ScanlineWriter::ScanlineWriter]: PNG files have 1 to 4 channels."));
+      this->file=std::fopen(filename.c_str(),"wb");
+      if(this->file==nullptr) throw(CoreException("Error: [ScanlineWriter::ScanlineWriter]: Cannot create "+filename));
+      this->png=png_create_write_struct(PNG_LIBPNG_VER_STRING,nullptr,nullptr,nullptr);
+      if(this->png!=nullptr) this->info=png_create_info_struct(this->png);
+      if(this->info==nullptr)
+      {
+        this->destroy();
+        throw(CoreException("Error: [ScanlineWriter::ScanlineWriter]: Cannot initialize libpng."));
+      }
+      if(setjmp(png_jmpbuf(this->png)))
+      {
+        this->destroy();
+        throw(CoreException("Error: [ScanlineWriter::ScanlineWriter]: Cannot write "+filename));
+      }
+      const int colorTypes[]={PNG_COLOR_TYPE_GRAY,PNG_COLOR_TYPE_GRAY_ALPHA,PNG_COLOR_TYPE_RGB,PNG_COLOR_TYPE_RGB_ALPHA};
+      png_init_io(this->png,this->file);
+      png_set_IHDR(this->png,this->info,width,height,this->eightBit?8:16,colorTypes[spectrum-1],
+                   PNG_INTERLACE_NONE,PNG_COMPRESSION_TYPE_DEFAULT,PNG_FILTER_TYPE_DEFAULT);
+      png_write_info(this->png,this->info);
+      if(!this->eightBit && little_endian()) png_set_swap(this->png);
+      this->row.resize((std::size_t)width*spectrum*(this->eightBit?1:2));
+    }
+    ~PngEncoder(){this->destroy();}
+    ///@see PngDecoder::destroy
+    void destroy()
+    {
+      if(this->png!=nullptr) png_destroy_write_struct(&this->png,this->info!=nullptr?&this->info:nullptr);
+      if(this->file!=nullptr) std::fclose(this->file);
+      this->png=nullptr;
+      this->info=nullptr;
+      this->file=nullptr;
+    }
+    void write_row(const char *src)
+    {
+      std::size_t n=(std::size_t)this->width*this->spectrum;
+      if(this->eightBit) std::memcpy(this->row.data(),src,n);
+      else clamp_samples(*this,src,(uint16_t*)this->row.data(),n,65535.0,this->tmp);
+      if(setjmp(png_jmpbuf(this->png))) throw(CoreException("Error: [ScanlineWriter::write_rows]: Cannot write "+this->filename));
+      png_write_row(this->png,(png_bytep)this->row.data());
+    }
+    void close()
+    {
+      if(setjmp(png_jmpbuf(this->png))) throw(CoreException("Error: [ScanlineWriter::close]: Cannot write "+this->filename));
+      png_write_end(this->png,nullptr);
+      int error=std::fclose(this->file);
+      this->file=nullptr;
+      if(error!=0) throw(CoreException("Error: [ScanlineWriter::close]: Cannot write "+this->filename));
+    }
+  };
+  #endif
+  #ifdef cimg_use_tiff
+  /** Rows of the pages of a TIFF file decoded by libtiff.
+   *  Tiled files are decoded one row of tiles at a time. Files with separate planes, palettes or samples shorter
+   *  than 8 bits have to be decoded by CImg (only the first page).
+   */
+  class TiffDecoder : public ScanlineDecoder
+  {
+    TIFF *tif=nullptr;
+    int nextRow=0;
+    bool tiled=false;
+    int tileWidth=0;
+    int tileHeight=0;
+    std::vector<char> tile;
+    ///Rows of tiles number _bandIndex_, columns \[_bandX1_,_bandX2_\] are decoded.
+    std::vector<char> band;
+    int bandIndex=-1;
+    int bandX1=0;
+    int bandX2=-1;
+    std::vector<char> row;
+    std::size_t pixel_size()const{return((std::size_t)this->spectrum*this->sampleBytes);}
+    ///Decode the tiles of row of tiles _index_, which intersect columns \[_x1_,_x2_\].
+    void load_band(int index,int x1,int x2)
+    {
+      if(index==this->bandIndex && x1>=this->bandX1 && x2<=this->bandX2) return;
+      std::size_t pixelSize=this->pixel_size();
+      this->tile.resize(TIFFTileSize(this->tif));
+      this->band.resize((std::size_t)this->tileHeight*this->width*pixelSize);
+      int top=index*this->tileHeight,numofRows=std::min(this->tileHeight,this->height-top);
+      x1=x1/this->tileWidth*this->tileWidth;
+      for(int x=x1;x<=x2;x+=this->tileWidth)
+      {
+        if(TIFFReadTile(this->tif,this->tile.data(),x,top,0,0)<0) throw(CoreException("Error: [ScanlineDecoder::read_row]: The TIFF file is damaged."));
+        std::size_t numofBytes=std::min(this->tileWidth,this->width-x)*pixelSize;
+        for(int r=0;r<numofRows;r++)
+          std::memcpy(this->band.data()+((std::size_t)r*this->width+x)*pixelSize,this->tile.data()+(std::size_t)r*this->tileWidth*pixelSize,numofBytes);
+      }
+      this->bandIndex=index;
+      this->bandX1=x1;
+      this->bandX2=x2;
+    }
+    ///Row _y_ (at least columns \[_x1_,_x2_\]), rows must be requested in increasing order.
+    const char* get_row(int y,int x1,int x2)
+    {
+      if(this->tiled)
+      {
+        this->load_band(y/this->tileHeight,x1,x2);
+        return(this->band.data()+(std::size_t)(y%this->tileHeight)*this->width*this->pixel_size());
+      }
+      this->row.resize(this->row_bytes());
+      if(TIFFReadScanline(this->tif,this->row.data(),y,0)<0) throw(CoreException("Error: [ScanlineDecoder::read_row]: The TIFF file is damaged."));
+      return(this->row.data());
+    }
+    ///Read the fields of the current directory (page).
+    void read_directory()
+    {
+      uint32_t width=0,height=0;
+      uint16_t samplesPerPixel=1,bitsPerSample=1,sampleFormat=SAMPLEFORMAT_UINT,planarConfig=PLANARCONFIG_CONTIG,photometric=PHOTOMETRIC_MINISBLACK;
+      TIFFGetField(this->tif,TIFFTAG_IMAGEWIDTH,&width);
+      TIFFGetField(this->tif,TIFFTAG_IMAGELENGTH,&height);
+      TIFFGetFieldDefaulted(this->tif,TIFFTAG_SAMPLESPERPIXEL,&samplesPerPixel);
+      TIFFGetFieldDefaulted(this->tif,TIFFTAG_BITSPERSAMPLE,&bitsPerSample);
+      TIFFGetFieldDefaulted(this->tif,TIFFTAG_SAMPLEFORMAT,&sampleFormat);
+      TIFFGetFieldDefaulted(this->tif,TIFFTAG_PLANARCONFIG,&planarConfig);
+      TIFFGetField(this->tif,TIFFTAG_PHOTOMETRIC,&photometric);
+      this->tiled=TIFFIsTiled(this->tif)!=0;
+      this->tileWidth=0;
+      this->tileHeight=0;
+      if(this->tiled)
+      {
+        uint32_t tileWidth=0,tileHeight=0;
+        TIFFGetField(this->tif,TIFFTAG_TILEWIDTH,&tileWidth);
+        TIFFGetField(this->tif,TIFFTAG_TILELENGTH,&tileHeight);
+        this->tileWidth=tileWidth;
+        this->tileHeight=tileHeight;
+      }
+      this->width=width;
+      this->height=height;
+      this->spectrum=samplesPerPixel;
+      this->sampleBytes=bitsPerSample/8;
+      this->sampleFormat=sampleFormat==SAMPLEFORMAT_INT?SampleFormat::Int:(sampleFormat==SAMPLEFORMAT_IEEEFP?SampleFormat::Float:SampleFormat::UInt);
+      bool supportedSamples=bitsPerSample%8==0 && (this->sampleFormat==SampleFormat::Float?bitsPerSample==32 || bitsPerSample==64:
+                                                   bitsPerSample==8 || bitsPerSample==16 || bitsPerSample==32 || bitsPerSample==64);
+      bool rowSize=this->tiled?this->tileWidth>0 && this->tileHeight>0 && (std::size_t)TIFFTileRowSize(this->tif)==this->tileWidth*this->pixel_size():
+                               (std::size_t)TIFFScanlineSize(this->tif)==this->row_bytes();
+      this->streamable=planarConfig==PLANARCONFIG_CONTIG && photometric!=PHOTOMETRIC_PALETTE &&
+                       (sampleFormat==SAMPLEFORMAT_UINT || sampleFormat==SAMPLEFORMAT_INT || sampleFormat==SAMPLEFORMAT_IEEEFP) &&
+                       supportedSamples && rowSize;
+      this->nextRow=0;
+      this->bandIndex=-1;
+    }
+    public:
+    ///False if the rows of the current page have to be decoded by CImg.
+    bool streamable=false;
+    TiffDecoder(const std::string &filename)
+    {
+      this->tif=TIFFOpen(filename.c_str(),"r");
+      if(this->tif==nullptr) throw(CoreException("Error: [ScanlineReader::ScanlineReader]: Cannot open "+filename));
+      this->numofPages=std::max(1,(int)TIFFNumberOfDirectories(this->tif));
+      this->read_directory();
+    }
+    ~TiffDecoder(){if(this->tif!=nullptr) TIFFClose(this->tif);}
+    void read_row(char *dst)
+    {
+      if(this->tiled) std::memcpy(dst,this->get_row(this->nextRow,0,this->width-1),this->row_bytes());
+      else if(TIFFReadScanline(this->tif,dst,this->nextRow,0)<0) throw(CoreException("Error: [ScanlineReader::read_rows]: The TIFF file is damaged."));
+      this->nextRow++;
+    }
+    bool next_page()
+    {
+      if(!TIFFReadDirectory(this->tif)) return(false);
+      this->read_directory();
+      if(!this->streamable) throw(CoreException("Error: [ScanlineReader::next_page]: Unsupported format of a page of the TIFF file."));
+      return(true);
+    }
+    ///Only the strips (rows) or tiles intersecting the rectangle are decoded.
+    void read_region(int x1,int y1,int x2,int y2,int step,char *dst)
+    {
+      for(int y=y1;y<=y2;y+=step) dst=gather_pixels(this->get_row(y,x1,x2),x1,x2,step,this->pixel_size(),dst);
+    }
+  };
+  /** Writer of uncompressed (multi-page) TIFF files with the samples stored as they are.
+   */
+  class TiffEncoder : public ScanlineEncoder
+  {
+    TIFF *tif=nullptr;
+    std::string filename;
+    int nextRow=0;
+    ///Set the fields of the current directory (page).
+    void write_directory()
+    {
+      TIFFSetField(this->tif,TIFFTAG_IMAGEWIDTH,(uint32_t)this->width);
+      TIFFSetField(this->tif,TIFFTAG_IMAGELENGTH,(uint32_t)this->height);
+      TIFFSetField(this->tif,TIFFTAG_SAMPLESPERPIXEL,(uint16_t)this->spectrum);
+      TIFFSetField(this->tif,TIFFTAG_BITSPERSAMPLE,(uint16_t)(8*this->sampleBytes));
+      TIFFSetField(this->tif,TIFFTAG_SAMPLEFORMAT,(uint16_t)(this->sampleFormat==SampleFormat::Int?SAMPLEFORMAT_INT:
+                                                            (this->sampleFormat==SampleFormat::Float?SAMPLEFORMAT_IEEEFP:SAMPLEFORMAT_UINT)));
+      TIFFSetField(this->tif,TIFFTAG_PLANARCONFIG,(uint16_t)PLANARCONFIG_CONTIG);
+      TIFFSetField(this->tif,TIFFTAG_PHOTOMETRIC,(uint16_t)(this->spectrum>=3?PHOTOMETRIC_RGB:PHOTOMETRIC_MINISBLACK));
+      TIFFSetField(this->tif,TIFFTAG_COMPRESSION,(uint16_t)COMPRESSION_NONE);
+      TIFFSetField(this->tif,TIFFTAG_ROWSPERSTRIP,TIFFDefaultStripSize(this->tif,0));
+      this->nextRow=0;
+    }
+    public:
+    TiffEncoder(const std::string &filename,int width,int height,int spectrum,SampleFormat sampleFormat,int sampleBytes) : filename(filename)
+    {
+      this->tif=TIFFOpen(filename.c_str(),"w");
+      if(this->tif==nullptr) throw(CoreException("Error: [ScanlineWriter::ScanlineWriter]: Cannot create "+filename));
+      this->width=width;
+      this->height=height;
+      this->spectrum=spectrum;
+      this->sampleFormat=sampleFormat;
+      this->sampleBytes=sampleBytes;
+      this->write_directory();
+    }
+    ~TiffEncoder(){if(this->tif!=nullptr) TIFFClose(this->tif);}
+    void write_row(const char *src)
+    {
+      if(TIFFWriteScanline(this->tif,(void*)src,this->nextRow,0)<0) throw(CoreException("Error: [ScanlineWriter::write_rows]: Cannot write "+this->filename));
+      this->nextRow++;
+    }
+    void next_page()
+    {
+      if(!TIFFWriteDirectory(this->tif)) throw(CoreException("Error: [ScanlineWriter::next_page]: Cannot write "+this->filename));
+      this->write_directory();
+    }
+    void close()
+    {
+      TIFFClose(this->tif);
+      this->tif=nullptr;
+    }
+  };
+  #endif
+}
+//-----------------------------------------------------------------------------
+std::unique_ptr<ScanlineDecoder> LibImageSegmentation::ScanlineDecoder::open(const std::string &filename,ScanlineFormat format,bool preferFloat,
+                                                                             char delimiter,bool ignoreBlankLines)
+{
+  if(format==ScanlineFormat::Auto)
+  {
+    char magic[8]={};
+    std::ifstream in(filename,std::ios::binary);
+    if(!in.good()) throw(CoreException("Error: [ScanlineReader::ScanlineReader]: File not found: "+filename));
+    in.read(magic,sizeof(magic));
+    std::string ext=extension(filename);
+    if(in.gcount()==sizeof(magic) && std::string(magic,8)==std::string(NativeHeader().magic,8)) format=ScanlineFormat::Native;
+    else if(ext=="png") format=ScanlineFormat::PNG;
+    else if(ext=="tif" || ext=="tiff") format=ScanlineFormat::TIFF;
+    else if(ext=="csv") format=ScanlineFormat::CSV;
+    else format=ScanlineFormat::CImg;
+  }
+  if(format==ScanlineFormat::CSV)
+  {
+    if(preferFloat) return(std::unique_ptr<ScanlineDecoder>(new CsvDecoder<double>(filename,delimiter,ignoreBlankLines)));
+    return(std::unique_ptr<ScanlineDecoder>(new CsvDecoder<int>(filename,delimiter,ignoreBlankLines)));
+  }
+  if(format==ScanlineFormat::Native) return(std::unique_ptr<ScanlineDecoder>(new NativeDecoder(filename)));
+  #ifdef cimg_use_png
+  if(format==ScanlineFormat::PNG)
+  {
+    std::unique_ptr<PngDecoder> ret(new PngDecoder(filename));
+    if(ret->streamable) return(std::unique_ptr<ScanlineDecoder>(ret.release()));
+  }
+  #endif
+  #ifdef cimg_use_tiff
+  if(format==ScanlineFormat::TIFF)
+  {
+    std::unique_ptr<TiffDecoder> ret(new TiffDecoder(filename));
+    if(ret->streamable) return(std::unique_ptr<ScanlineDecoder>(ret.release()));
+  }
+  #endif
+  return(std::unique_ptr<ScanlineDecoder>(new ScanlineCImgDecoder(filename)));
+}
+//-----------------------------------------------------------------------------
+void LibImageSegmentation::ScanlineDecoder::read_region(int x1,int y1,int x2,int y2,int step,char *dst)
+{
+  std::vector<char> row(this->row_bytes());
+  std::size_t pixelSize=(std::size_t)this->spectrum*this->sampleBytes;
+  for(int y=0;y<=y2;y++)
+  {
+    this->read_row(row.data());
+    if(y>=y1 && (y-y1)%step==0) dst=gather_pixels(row.data(),x1,x2,step,pixelSize,dst);
+  }
+}
+//-----------------------------------------------------------------------------
+std::unique_ptr<ScanlineEncoder> LibImageSegmentation::ScanlineEncoder::create(const std::string &filename,ScanlineFormat format,int width,int height,int spectrum,
+                                                                               SampleFormat sampleFormat,int sampleBytes,char delimiter)
+{
+  if(width<0 || height<0 || spectrum<1) throw(DimensionException("Error: [ScanlineWriter::ScanlineWriter]: Invalid dimensions of the image."));
+  if(format==ScanlineFormat::Auto)
+  {
+    std::string ext=extension(filename);
+    if(ext=="png") format=ScanlineFormat::PNG;
+    else if(ext=="tif" || ext=="tiff") format=ScanlineFormat::TIFF;
+    else if(ext=="csv") format=ScanlineFormat::CSV;
+    else if(ext=="lisn") format=ScanlineFormat::Native;
+    else format=ScanlineFormat::CImg;
+  }
+  bool convertible=sampleBytes==1 || sampleBytes==2 || sampleBytes==4 || sampleBytes==8;
+  if(sampleFormat==SampleFormat::Float) convertible=sampleBytes==4 || sampleBytes==8;
+  if(!convertible && format!=ScanlineFormat::CSV && format!=ScanlineFormat::Native)
+    throw(CoreException("Error: [ScanlineWriter::ScanlineWriter]: Unsupported type of the samples for "+filename));
+  std::unique_ptr<ScanlineEncoder> ret;
+  if(format==ScanlineFormat::CSV)
+  {
+    if(spectrum!=1) throw(DimensionException("Error: [ScanlineWriter::ScanlineWriter]: Only 1 channel images can be saved as CSV."));
+    ret.reset(new CsvEncoder(filename,delimiter));
+  }
+  else if(format==ScanlineFormat::Native) ret.reset(new NativeEncoder(filename,width,height,spectrum,sampleFormat,sampleBytes));
+  #ifdef cimg_use_png
+  else if(format==ScanlineFormat::PNG) ret.reset(new PngEncoder(filename,width,height,spectrum,sampleFormat,sampleBytes));
+  #endif
+  #ifdef cimg_use_tiff
+  else if(format==ScanlineFormat::TIFF) ret.reset(new TiffEncoder(filename,width,height,spectrum,sampleFormat,sampleBytes));
+  #endif
+  else ret.reset(new ScanlineCImgEncoder(filename,width,height,spectrum));
+  ret->width=width;
+  ret->height=height;
+  ret->spectrum=spectrum;
+  ret->sampleFormat=sampleFormat;
+  ret->sampleBytes=sampleBytes;
+  return(ret);
+}
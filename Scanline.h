@@ -0,0 +1,288 @@
+#ifndef LIB_IMAGE_SEGMENTATION_SCANLINE_H
+#define LIB_IMAGE_SEGMENTATION_SCANLINE_H
+#include <memory>
+#include "ImageSegmentation.h"
+namespace LibImageSegmentation
+{
+  /** File formats of ScanlineReader and ScanlineWriter.
+   *  Auto chooses the format by the signature (native files) or by the extension (.png, .tif, .tiff, .csv, .lisn).
+   *  PNG and TIFF need libpng and libtiff (cimg_use_png and cimg_use_tiff). Other formats and interlaced PNGs
+   *  are loaded (saved) as a whole by CImg, so they need memory for the whole image.
+   */
+  enum class ScanlineFormat{Auto,PNG,TIFF,CSV,Native,CImg};
+  ///Representation of the samples of a row.
+  enum class SampleFormat{UInt,Int,Float};
+  //-----------------------------------------------------------------------------
+  /** Source of the rows of an image file, the backend of ScanlineReader.
+   *  The rows are read from top to bottom, each row consists of width*spectrum interleaved samples
+   *  of sampleBytes bytes in the native byte order.
+   */
+  class ScanlineDecoder
+  {
+    public:
+    int width=0;
+    int height=0;
+    int spectrum=0;
+    SampleFormat sampleFormat=SampleFormat::UInt;
+    int sampleBytes=1;
+    ///Number of pages (directories of multi-page TIFF files), 1 for the other formats.
+    int numofPages=1;
+    virtual ~ScanlineDecoder(){}
+    ///Read the next row into _dst_.
+    virtual void read_row(char *dst)=0;
+    /** Move to the first row of the next page and update the dimensions.
+     *  @return False if there is no next page.
+     */
+    virtual bool next_page(){return(false);}
+    /** Read pixels \[_x1_+i*_step_,_y1_+j*_step_\] of rectangle \[_x1_,_y1_\]-\[_x2_,_y2_\], which lies inside the image,
+     *  into _dst_ row by row (((_x2_-_x1_)/_step_+1)*((_y2_-_y1_)/_step_+1) pixels). It replaces read_row, the decoder
+     *  cannot be used after it. The default implementation reads the rows up to _y2_ by read_row.
+     */
+    virtual void read_region(int x1,int y1,int x2,int y2,int step,char *dst);
+    ///Size of one row in bytes.
+    std::size_t row_bytes()const{return((std::size_t)this->width*this->spectrum*this->sampleBytes);}
+    /** Open _filename_.
+     *  @param preferFloat CSV items are parsed by atof if true and by atoi otherwise.
+     *  @param delimiter,ignoreBlankLines CSV options, see ImageSegmentation::load_csv.
+     *  @throw CoreException if the file cannot be opened.
+     */
+    static std::unique_ptr<ScanlineDecoder> open(const std::string &filename,ScanlineFormat format,bool preferFloat,char delimiter,bool ignoreBlankLines);
+  };
+  /** Destination of the rows of an image file, the backend of ScanlineWriter.
+   *  @see ScanlineDecoder
+   */
+  class ScanlineEncoder
+  {
+    public:
+    int width=0;
+    int height=0;
+    int spectrum=0;
+    SampleFormat sampleFormat=SampleFormat::UInt;
+    int sampleBytes=1;
+    virtual ~ScanlineEncoder(){}
+    ///Write the next row from _src_.
+    virtual void write_row(const char *src)=0;
+    ///Finish the file after the last row.
+    virtual void close()=0;
+    /** Finish the current page after its last row and start a new one of the same size.
+     *  @throw CoreException if the format cannot store more pages (only TIFF files can).
+     */
+    virtual void next_page(){throw(CoreException("Error: [ScanlineWriter::next_page]: The format cannot store more pages."));}
+    ///Size of one row in bytes.
+    std::size_t row_bytes()const{return((std::size_t)this->width*this->spectrum*this->sampleBytes);}
+    /** Create _filename_ for an image of size \[_width_,_height_\] with _spectrum_ channels.
+     *  @throw CoreException if the file cannot be created.
+     *  @throw DimensionException if the format cannot store _spectrum_ channels.
+     */
+    static std::unique_ptr<ScanlineEncoder> create(const std::string &filename,ScanlineFormat format,int width,int height,int spectrum,
+                                                   SampleFormat sampleFormat,int sampleBytes,char delimiter);
+  };
+  //-----------------------------------------------------------------------------
+  ///Sample format of type _S_.
+  template <class S> SampleFormat sample_format(){return(std::is_floating_point<S>::value?SampleFormat::Float:(std::is_signed<S>::value?SampleFormat::Int:SampleFormat::UInt));}
+  /** Convert _n_ samples from _src_ (format _format_, _bytes_ bytes each) to _dst_.
+   *  @return False if the format is not supported.
+   */
+  template <class S> bool convert_samples(const char *src,SampleFormat format,int bytes,S *dst,std::size_t n)
+  {
+    #define LIS_CONVERT_SAMPLES(type) {const type *s=(const type*)src;for(std::size_t i=0;i<n;i++) dst[i]=(S)s[i];return(true);}
+    if(format==SampleFormat::UInt)
+    {
+      if(bytes==1) LIS_CONVERT_SAMPLES(uint8_t)
+      if(bytes==2) LIS_CONVERT_SAMPLES(uint16_t)
+      if(bytes==4) LIS_CONVERT_SAMPLES(uint32_t)
+      if(bytes==8) LIS_CONVERT_SAMPLES(uint64_t)
+    }
+    else if(format==SampleFormat::Int)
+    {
+      if(bytes==1) LIS_CONVERT_SAMPLES(int8_t)
+      if(bytes==2) LIS_CONVERT_SAMPLES(int16_t)
+      if(bytes==4) LIS_CONVERT_SAMPLES(int32_t)
+      if(bytes==8) LIS_CONVERT_SAMPLES(int64_t)
+    }
+    else
+    {
+      if(bytes==4) LIS_CONVERT_SAMPLES(float)
+      if(bytes==8) LIS_CONVERT_SAMPLES(double)
+    }
+    #undef LIS_CONVERT_SAMPLES
+    return(false);
+  }
+  //-----------------------------------------------------------------------------
+  /** Sequential reader of the rows of an image file.
+   *  Only one row of the file is kept in memory (except the formats loaded by CImg, see ScanlineFormat), so row-local
+   *  operations like thresholding, grayscale conversion or palette mapping can process images of any height.
+   *  The samples of a row are interleaved, sample _c_ of pixel _x_ is at index _x_*spectrum+_c_.
+   *  The pages of multi-page TIFF files are read one after another by next_page (the other formats and the TIFF files
+   *  decoded by CImg have only one page).
+   * @tparam S Type of the samples, the samples of the file are converted by a cast.
+   */
+  template <class S> class ScanlineReader
+  {
+    std::unique_ptr<ScanlineDecoder> decoder;
+    std::vector<char> row;
+    int nextRow=0;
+    public:
+    ///Width of the image.
+    int width=0;
+    ///Height of the image.
+    int height=0;
+    ///Number of samples per pixel.
+    int spectrum=0;
+    ///Number of pages.
+    int numofPages=1;
+    ///Index of the current page.
+    int page=0;
+    /** Constructor.
+     *  Opens _filename_ and reads the dimensions of its first page.
+     *  @param delimiter,ignoreBlankLines CSV options, see ImageSegmentation::load_csv.
+     *  @throw CoreException if the file cannot be opened.
+     */
+    ScanlineReader(const std::string &filename,ScanlineFormat format=ScanlineFormat::Auto,char delimiter=',',bool ignoreBlankLines=true)
+    {
+      this->decoder=ScanlineDecoder::open(filename,format,std::is_floating_point<S>::value,delimiter,ignoreBlankLines);
+      this->numofPages=this->decoder->numofPages;
+      this->update_dimensions();
+    }
+    ///Number of rows of the current page read so far.
+    int rows_read()const{return(this->nextRow);}
+    /** Move to the first row of the next page, the dimensions are updated (the pages may differ in size).
+     *  @return False if there is no next page.
+     *  @throw CoreException if the page cannot be streamed (see ScanlineFormat).
+     */
+    bool next_page()
+    {
+      if(!this->decoder->next_page()) return(false);
+      this->page++;
+      this->update_dimensions();
+      return(true);
+    }
+    /** Read the next rows.
+     *  @param dst Buffer for _numofRows_*width*spectrum samples.
+     *  @return Number of rows read, it is less than _numofRows_ at the end of the image.
+     *  @throw BadCSVFormatException if a CSV file has rows of different length or an unexpected blank line.
+     */
+    int read_rows(S *dst,int numofRows=1)
+    {
+      int n=std::max(0,std::min(numofRows,this->height-this->nextRow));
+      std::size_t rowSamples=(std::size_t)this->width*this->spectrum;
+      for(int r=0;r<n;r++)
+      {
+        this->decoder->read_row(this->row.data());
+        convert_samples(this->row.data(),this->decoder->sampleFormat,this->decoder->sampleBytes,dst+r*rowSamples,rowSamples);
+        this->nextRow++;
+      }
+      return(n);
+    }
+    private:
+    void update_dimensions()
+    {
+      this->width=this->decoder->width;
+      this->height=this->decoder->height;
+      this->spectrum=this->decoder->spectrum;
+      this->row.resize(this->decoder->row_bytes());
+      this->nextRow=0;
+    }
+  };
+  //-----------------------------------------------------------------------------
+  /** Sequential writer of the rows of an image file.
+   *  @see ScanlineReader
+   * @tparam S Type of the samples. PNG files are 8-bit for uint8_t samples and 16-bit otherwise (the samples are clamped),
+   *           TIFF and native files store the samples as they are.
+   */
+  template <class S> class ScanlineWriter
+  {
+    std::unique_ptr<ScanlineEncoder> encoder;
+    int nextRow=0;
+    public:
+    ///Width of the image.
+    int width=0;
+    ///Height of the image.
+    int height=0;
+    ///Number of samples per pixel.
+    int spectrum=0;
+    /** Constructor.
+     *  Creates _filename_ for an image of size \[_width_,_height_\] with _spectrum_ samples per pixel.
+     *  Native files can be loaded by ImageSegmentation<S,_spectrum_,RowMajor>::load_native.
+     *  @param delimiter Delimiter of CSV files (only 1 channel images can be saved as CSV).
+     */
+    ScanlineWriter(const std::string &filename,int width,int height,int spectrum=1,ScanlineFormat format=ScanlineFormat::Auto,char delimiter=',')
+    {
+      this->encoder=ScanlineEncoder::create(filename,format,width,height,spectrum,sample_format<S>(),sizeof(S),delimiter);
+      this->width=width;
+      this->height=height;
+      this->spectrum=spectrum;
+    }
+    ScanlineWriter(const ScanlineWriter<S>&)=delete;
+    ScanlineWriter<S>& operator=(const ScanlineWriter<S>&)=delete;
+    ///Finish the file.
+    ~ScanlineWriter()
+    {
+      try{this->close();}
+      catch(...){}
+    }
+    ///Number of rows of the current page written so far.
+    int rows_written()const{return(this->nextRow);}
+    /** Write the next _numofRows_ rows from _src_ (_numofRows_*width*spectrum samples).
+     *  @throw DimensionException if the rows do not fit into the image.
+     */
+    void write_rows(const S *src,int numofRows=1)
+    {
+      if(this->encoder==nullptr || this->nextRow+numofRows>this->height)
+        throw(DimensionException("Error: [ScanlineWriter::write_rows]: The rows do not fit into the image."));
+      std::size_t rowSamples=(std::size_t)this->width*this->spectrum;
+      for(int r=0;r<numofRows;r++) this->encoder->write_row((const char*)(src+r*rowSamples));
+      this->nextRow+=numofRows;
+    }
+    /** Finish the current page and start a new page of the same size (multi-page TIFF files),
+     *  the missing rows of the current page are filled by zeros.
+     *  @throw CoreException if the format cannot store more pages.
+     */
+    void next_page()
+    {
+      if(this->encoder==nullptr) throw(CoreException("Error: [ScanlineWriter::next_page]: The file is closed."));
+      this->fill_page();
+      this->encoder->next_page();
+      this->nextRow=0;
+    }
+    /** Finish the file, the missing rows are filled by zeros.
+     *  Formats saved by CImg are written now.
+     */
+    void close()
+    {
+      if(this->encoder==nullptr) return;
+      this->fill_page();
+      std::unique_ptr<ScanlineEncoder> encoder(std::move(this->encoder));
+      encoder->close();
+    }
+    private:
+    void fill_page()
+    {
+      std::vector<S> zeros((std::size_t)this->width*this->spectrum,S(0));
+      while(this->nextRow<this->height) this->write_rows(zeros.data());
+    }
+  };
+  //-----------------------------------------------------------------------------
+  /** Apply a pixel-wise operation (thresholding, grayscale conversion, palette mapping, ...) to image file _srcFilename_
+   *  and save the result into _dstFilename_. Only _numofRows_ rows of both images are kept in memory.
+   *  @param dstSpectrum Number of samples per pixel of the result.
+   *  @param f A callable with arguments (const S *src,D *dst), which computes the _dstSpectrum_ samples of a pixel from
+   *           its samples in the source.
+   */
+  template <class S,class D,class F> void transform_rows(const std::string &srcFilename,const std::string &dstFilename,int dstSpectrum,F f,int numofRows=64)
+  {
+    ScanlineReader<S> reader(srcFilename);
+    ScanlineWriter<D> writer(dstFilename,reader.width,reader.height,dstSpectrum);
+    numofRows=std::max(1,numofRows);
+    std::vector<S> src((std::size_t)numofRows*reader.width*reader.spectrum);
+    std::vector<D> dst((std::size_t)numofRows*reader.width*dstSpectrum);
+    for(int n=reader.read_rows(src.data(),numofRows);n>0;n=reader.read_rows(src.data(),numofRows))
+    {
+      std::size_t numofPixels=(std::size_t)n*reader.width;
+      for(std::size_t i=0;i<numofPixels;i++) f(src.data()+i*reader.spectrum,dst.data()+i*dstSpectrum);
+      writer.write_rows(dst.data(),n);
+    }
+    writer.close();
+  }
+}
+#endif
@@ -0,0 +1,433 @@
+#ifndef LIB_IMAGE_SEGMENTATION_TILED_IMAGE_H
+#define LIB_IMAGE_SEGMENTATION_TILED_IMAGE_H
+#include <deque>
+#include <unordered_map>
+#include "ImageSegmentation.h"
+namespace LibImageSegmentation
+{
+  /** Segmentation or image stored on disk in tiles of a fixed size.
+   *  The tiles are loaded lazily into a bounded LRU cache and written back when they are evicted or flushed,
+   *  so the memory needed for gigapixel images is capped by the cache budget. The file uses the native format
+   *  (see NativeHeader), the tiles are stored one after another in row-major order and every tile (including
+   *  the partial tiles at the right and bottom border) has \[tileWidth,tileHeight\] pixels stored row by row.
+   * @tparam T Underlying type.
+   * @tparam N Number of channels.
+   */
+  template <class T,int N> class TiledImage
+  {
+    public:
+    ///@see ImageSegmentation::color_type
+    using color_type=typename __ImageTypes<T,N>::color_type;
+    ///Type of one tile.
+    using tile_type=ImageSegmentation<T,N,RowMajor>;
+    ///Default size of the tile cache in bytes.
+    static const std::size_t defaultCacheBytes=(std::size_t)256*1024*1024;
+    ///Width (number of columns).
+    int width=0;
+    ///Height (number of rows).
+    int height=0;
+    ///Width of one tile.
+    int tileWidth=0;
+    ///Height of one tile.
+    int tileHeight=0;
+    ///Number of tile requests served from the cache.
+    std::size_t hits=0;
+    ///Number of tile requests, which needed to load (or create) the tile.
+    std::size_t misses=0;
+    ///Number of tiles evicted from the cache.
+    std::size_t evictions=0;
+    ///Number of dirty tiles written to the file.
+    std::size_t writebacks=0;
+    /** Constructor.
+     *  Creates an empty image without a file.
+     */
+    TiledImage(){}
+    /** Constructor.
+     *  Opens an existing tiled image.
+     *  @see open(const std::string &filename,std::size_t cacheBytes)
+     */
+    TiledImage(const std::string &filename,std::size_t cacheBytes=defaultCacheBytes){this->open(filename,cacheBytes);}
+    /** Constructor.
+     *  Creates a new tiled image.
+     *  @see create(const std::string &filename,int width,int height,int tileWidth,int tileHeight,std::size_t cacheBytes)
+     */
+    TiledImage(const std::string &filename,int width,int height,int tileWidth=256,int tileHeight=256,std::size_t cacheBytes=defaultCacheBytes)
+    {
+      this->create(filename,width,height,tileWidth,tileHeight,cacheBytes);
+    }
+    TiledImage(const TiledImage<T,N>&)=delete;
+    TiledImage<T,N>& operator=(const TiledImage<T,N>&)=delete;
+    /** Write the dirty tiles back and close the file.
+     *  Write errors cannot be reported here and the tiles, which were not written, are lost. Call close() to detect them.
+     */
+    ~TiledImage()
+    {
+      try{this->close();}
+      catch(...){this->file.close();}
+    }
+    //-------------------------------------------------------------------------
+    /** Open an existing tiled image _filename_.
+     *  @param cacheBytes Maximum memory occupied by the cached tiles (at least one tile is always cached).
+     *  @throw CoreException if the file cannot be opened.
+     *  @throw BadNativeFormatException if the file does not contain a tiled image of this type.
+     */
+    void open(const std::string &filename,std::size_t cacheBytes=defaultCacheBytes)
+    {
+      this->close();
+      this->file.open(filename,std::ios::in|std::ios::out|std::ios::binary);
+      if(!this->file.is_open()) throw(CoreException("Error: [TiledImage::open]: Cannot open "+filename+"."));
+      NativeHeader header;
+      this->file.read((char*)&header,sizeof(header));
+      if(this->file.gcount()!=sizeof(header) || header.tileWidth<=0 || header.tileHeight<=0 ||
+         !header.is_compatible(NativeHeader::create<T,N,color_type>(0,0,true,header.tileWidth,header.tileHeight)))
+      {
+        this->file.close();
+        throw(BadNativeFormatException("Error: [TiledImage::open]: "+filename+" does not contain a tiled image of this type."));
+      }
+      this->init(header.width,header.height,header.tileWidth,header.tileHeight,cacheBytes);
+    }
+    /** Create (or overwrite) tiled image _filename_ of size \[_width_,_height_\] filled by zeros.
+     *  The tiles are written to the file only when they are modified.
+     *  @param cacheBytes Maximum memory occupied by the cached tiles (at least one tile is always cached).
+     *  @throw CoreException if the file cannot be created.
+     */
+    void create(const std::string &filename,int width,int height,int tileWidth=256,int tileHeight=256,std::size_t cacheBytes=defaultCacheBytes)
+    {
+      this->close();
+      width=std::max(width,0);
+      height=std::max(height,0);
+      tileWidth=std::max(tileWidth,1);
+      tileHeight=std::max(tileHeight,1);
+      this->file.open(filename,std::ios::in|std::ios::out|std::ios::binary|std::ios::trunc);
+      if(!this->file.is_open()) throw(CoreException("Error: [TiledImage::create]: Cannot create "+filename+"."));
+      NativeHeader header=NativeHeader::create<T,N,color_type>(width,height,true,tileWidth,tileHeight);
+      this->file.write((const char*)&header,sizeof(header));
+      this->init(width,height,tileWidth,tileHeight,cacheBytes);
+    }
+    /** Write all dirty tiles to the file.
+     *  @throw CoreException if a tile cannot be written, the tiles which were not written stay dirty in the cache.
+     */
+    void flush()
+    {
+      for(auto &&entry: this->cache) this->write_back(entry);
+      this->file.flush();
+      if(!this->file.good()) throw(CoreException("Error: [TiledImage::flush]: Cannot write to the file."));
+    }
+    /** Write all dirty tiles back, release the cache and close the file.
+     *  @throw CoreException if a tile cannot be written, the image then stays open and the tiles which were not written
+     *         stay dirty in the cache.
+     */
+    void close()
+    {
+      if(this->file.is_open())
+      {
+        this->flush();
+        this->file.close();
+      }
+      this->cache.clear();
+      this->cacheIndex.clear();
+      this->width=0;
+      this->height=0;
+      this->tileWidth=0;
+      this->tileHeight=0;
+    }
+    /** Change the maximum memory occupied by the cached tiles. The least recently used tiles are evicted if necessary.
+     *  @throw CoreException if an evicted dirty tile cannot be written.
+     */
+    void set_cache_size(std::size_t cacheBytes)
+    {
+      std::size_t tileBytes=std::max<std::size_t>(1,(std::size_t)this->tileWidth*this->tileHeight*sizeof(color_type));
+      this->cacheCapacity=std::max<std::size_t>(1,cacheBytes/tileBytes);
+      while(this->cache.size()>this->cacheCapacity) this->evict();
+    }
+    ///Maximum number of cached tiles.
+    std::size_t cache_capacity()const{return(this->cacheCapacity);}
+    ///Number of currently cached tiles.
+    std::size_t numof_cached_tiles()const{return(this->cache.size());}
+    ///Number of tiles in a row.
+    int numof_tiles_x()const{return(this->tilesX);}
+    ///Number of tiles in a column.
+    int numof_tiles_y()const{return(this->tilesY);}
+    ///Set all counters (hits, misses, evictions, writebacks) to 0.
+    void reset_statistics(){this->hits=0;this->misses=0;this->evictions=0;this->writebacks=0;}
+    //-------------------------------------------------------------------------
+    /** Tile \[_tileX_,_tileY_\], the tile is loaded if it is not cached.
+     *  The reference is valid only until the next access to another tile.
+     *  @param modify If true, the tile is marked dirty and it will be written back to the file.
+     */
+    tile_type& tile(int tileX,int tileY,bool modify=false){return(this->fetch(tileX,tileY,modify,true));}
+    /** Determines, whether pixel \[_x_,_y_\] is inside the image.
+     */
+    bool is_pixel_inside(int x,int y)const{return(x>=0 && x<this->width && y>=0 && y<this->height);}
+    /** Value of pixel \[_x_,_y_\], the pixel must lie inside the image.
+     */
+    color_type get_pixel(int x,int y)
+    {
+      return(this->fetch(x/this->tileWidth,y/this->tileHeight,false,true).data[x%this->tileWidth][y%this->tileHeight]);
+    }
+    /** Value of pixel \[_x_,_y_\].
+     *  @see ImageSegmentation::get_pixel_safe(int x,int y)const
+     */
+    color_type get_pixel_safe(int x,int y)
+    {
+      color_type ret{};
+      if(std::is_signed<T>::value) ret=color_type{-1};
+      if(this->is_pixel_inside(x,y)) ret=this->get_pixel(x,y);
+      return(ret);
+    }
+    /** Set value of pixel \[_x_,_y_\], the pixel must lie inside the image.
+     */
+    void set_pixel(int x,int y,const color_type &color)
+    {
+      this->fetch(x/this->tileWidth,y/this->tileHeight,true,true).data[x%this->tileWidth][y%this->tileHeight]=color;
+    }
+    //-------------------------------------------------------------------------
+    /** Copy rectangle \[_x1_,_y1_\]-\[_x2_,_y2_\] of this image into _res_, which is reallocated to the size of the rectangle.
+     *  The parts of the rectangle that lie outside the image are omitted.
+     */
+    template <class Layout> void read_region(int x1,int y1,int x2,int y2,ImageSegmentation<T,N,Layout> &res)
+    {
+      x1=std::max(x1,0);
+      y1=std::max(y1,0);
+      x2=std::min(x2,this->width-1);
+      y2=std::min(y2,this->height-1);
+      if(x1>x2 || y1>y2) {res.release();return;}
+      res.reallocate(x2-x1+1,y2-y1+1);
+      this->for_each_tile(x1,y1,x2,y2,false,true,[&](tile_type &t,int ox,int oy,int tx1,int ty1,int tx2,int ty2)
+      {
+        for(int y=ty1;y<=ty2;y++)
+          for(int x=tx1;x<=tx2;x++)
+            res.data[ox+x-x1][oy+y-y1]=t.data[x][y];
+      });
+    }
+    /** Copy _source_ into this image, pixel \[0,0\] of _source_ is copied to \[_targetX_,_targetY_\].
+     *  The pixels that do not fit into this image are omitted.
+     */
+    template <class Layout> void write_region(const ImageView<T,N,Layout> &source,int targetX=0,int targetY=0)
+    {
+      int x1=std::max(targetX,0);
+      int y1=std::max(targetY,0);
+      int x2=std::min(targetX+source.width-1,this->width-1);
+      int y2=std::min(targetY+source.height-1,this->height-1);
+      if(x1>x2 || y1>y2) return;
+      this->for_each_tile(x1,y1,x2,y2,true,true,[&](tile_type &t,int ox,int oy,int tx1,int ty1,int tx2,int ty2)
+      {
+        for(int y=ty1;y<=ty2;y++)
+          for(int x=tx1;x<=tx2;x++)
+            t.data[x][y]=source.data[ox+x-targetX][oy+y-targetY];
+      },true);
+    }
+    /** Init all pixels to _color_. The tiles are not read from the file.
+     */
+    void init_data(const color_type &color)
+    {
+      for(int ty=0;ty<this->tilesY;ty++)
+        for(int tx=0;tx<this->tilesX;tx++)
+          this->fetch(tx,ty,true,false).init_data(color);
+    }
+    /** Return number of occurences of _l_ in the image.
+     */
+    std::size_t count_label(const color_type &l)
+    {
+      std::size_t ret=0;
+      this->for_each_tile(0,0,this->width-1,this->height-1,false,true,[&](tile_type &t,int ox,int oy,int tx1,int ty1,int tx2,int ty2)
+      {
+        ret+=t.view(tx1,ty1,tx2,ty2).count_label(l);
+      });
+      return(ret);
+    }
+    //-------------------------------------------------------------------------
+    /** Implements Matlab function conv2(source,filter,'same') and stores the result into this image.
+     *  The convolution is computed tile by tile, only the tile and its neighborhood covered by the filter are
+     *  needed in the memory. This image must have the same size as _source_ and it must not be _source_.
+     *  @see ImageSegmentation::conv2(const view_type &source,const ImageSegmentation<T,N,Layout> &filter,int filterCenterX,int filterCenterY,bool boundariesNormalizeBrightness)
+     *  @throw DimensionException if the sizes of this image and _source_ differ.
+     */
+    template <class Layout> void conv2(TiledImage<T,N> &source,const ImageSegmentation<T,N,Layout> &filter,bool boundariesNormalizeBrightness=true)
+    {
+      this->conv2(source,filter,filter.width/2,filter.height/2,boundariesNormalizeBrightness);
+    }
+    /** Implements Matlab function conv2(source,filter,'same') and stores the result into this image.
+     *  @see conv2(TiledImage<T,N> &source,const ImageSegmentation<T,N,Layout> &filter,bool boundariesNormalizeBrightness)
+     */
+    template <class Layout> void conv2(TiledImage<T,N> &source,const ImageSegmentation<T,N,Layout> &filter,
+                                       int filterCenterX,int filterCenterY,bool boundariesNormalizeBrightness=true)
+    {
+      static_assert(std::is_arithmetic<T>::value,"Error [TiledImage::conv2]: The underlying type must be arithmetic.");
+      if(&source==this || source.width!=this->width || source.height!=this->height)
+        throw(DimensionException("Error: [TiledImage::conv2]: The result must be a different image of the same size as the source."));
+      tile_type rowMajorFilter(filter.width,filter.height),region,res;
+      rowMajorFilter.traverse([&](int x,int y){rowMajorFilter.data[x][y]=filter.data[x][y];});
+      for(int ty=0;ty<this->tilesY;ty++)
+      {
+        for(int tx=0;tx<this->tilesX;tx++)
+        {
+          int x1=tx*this->tileWidth,y1=ty*this->tileHeight;
+          int x2=std::min(x1+this->tileWidth,this->width)-1,y2=std::min(y1+this->tileHeight,this->height)-1;
+          int rx1=std::max(0,x1-(filter.width-1-filterCenterX)),ry1=std::max(0,y1-(filter.height-1-filterCenterY));
+          source.read_region(rx1,ry1,x2+filterCenterX,y2+filterCenterY,region);
+          res.conv2(region.view(),rowMajorFilter,filterCenterX,filterCenterY,boundariesNormalizeBrightness);
+          this->fetch(tx,ty,true,false).copy_data(res.view(x1-rx1,y1-ry1,x2-rx1,y2-ry1));
+        }
+      }
+    }
+    //-------------------------------------------------------------------------
+    /** Flood fill algorithm.
+     *  Only the tiles reached by the flooded region are loaded.
+     *  @see ImageSegmentation::flood_fill(int startX,int startY,const T &targetLabel,std::vector<Pixel<int> > &resPixels,bool overwriteImage,bool eightNeighborhood)
+     */
+    void flood_fill(int startX,int startY,const T &targetLabel,std::vector<Pixel<int> > &resPixels,bool eightNeighborhood=false)
+    {
+      resPixels.clear();
+      if(!this->is_pixel_inside(startX,startY)) return;
+      T sourceLabel=this->get_pixel(startX,startY);
+      if(sourceLabel==targetLabel) return;
+      std::deque<Pixel<int> > pixels;
+      auto add_pixel=[&](int x,int y)
+      {
+        if(this->is_pixel_inside(x,y) && this->get_pixel(x,y)==sourceLabel)
+        {
+          this->set_pixel(x,y,targetLabel);
+          pixels.emplace_back(x,y);
+        }
+      };
+      add_pixel(startX,startY);
+      while(!pixels.empty())
+      {
+        Pixel<int> p=pixels.front();
+        pixels.pop_front();
+        resPixels.push_back(p);
+        add_pixel(p.x-1,p.y);
+        add_pixel(p.x,p.y-1);
+        add_pixel(p.x+1,p.y);
+        add_pixel(p.x,p.y+1);
+        if(eightNeighborhood)
+        {
+          add_pixel(p.x-1,p.y-1);
+          add_pixel(p.x+1,p.y-1);
+          add_pixel(p.x-1,p.y+1);
+          add_pixel(p.x+1,p.y+1);
+        }
+      }
+    }
+    /** Flood fill algorithm.
+     *  @see flood_fill(int startX,int startY,const T &targetLabel,std::vector<Pixel<int> > &resPixels,bool eightNeighborhood)
+     */
+    void flood_fill(const Pixel<int> &startZ,const T &targetLabel,std::vector<Pixel<int> > &resPixels,bool eightNeighborhood=false)
+    {
+      this->flood_fill(startZ.x,startZ.y,targetLabel,resPixels,eightNeighborhood);
+    }
+    //-------------------------------------------------------------------------
+    protected:
+    struct CacheEntry
+    {
+      std::size_t index;
+      tile_type tile;
+      bool dirty;
+    };
+    using cache_iterator=typename std::list<CacheEntry>::iterator;
+    std::fstream file;
+    int tilesX=0;
+    int tilesY=0;
+    std::size_t cacheCapacity=1;
+    ///Tiles ordered from the most recently used.
+    std::list<CacheEntry> cache;
+    std::unordered_map<std::size_t,cache_iterator> cacheIndex;
+    void init(int width,int height,int tileWidth,int tileHeight,std::size_t cacheBytes)
+    {
+      this->width=width;
+      this->height=height;
+      this->tileWidth=tileWidth;
+      this->tileHeight=tileHeight;
+      this->tilesX=(width+tileWidth-1)/tileWidth;
+      this->tilesY=(height+tileHeight-1)/tileHeight;
+      this->set_cache_size(cacheBytes);
+    }
+    std::size_t tile_bytes()const{return((std::size_t)this->tileWidth*this->tileHeight*sizeof(color_type));}
+    std::streamoff tile_offset(std::size_t index)const{return(sizeof(NativeHeader)+index*this->tile_bytes());}
+    /** Return tile \[_tileX_,_tileY_\] and move it to the front of the cache.
+     *  @param load If false and the tile is not cached, it is created filled by zeros instead of reading it.
+     */
+    tile_type& fetch(int tileX,int tileY,bool modify,bool load)
+    {
+      std::size_t index=(std::size_t)tileY*this->tilesX+tileX;
+      if(!this->cache.empty() && this->cache.front().index==index) this->hits++;
+      else
+      {
+        auto it=this->cacheIndex.find(index);
+        if(it!=this->cacheIndex.end())
+        {
+          this->hits++;
+          this->cache.splice(this->cache.begin(),this->cache,it->second);
+        }
+        else
+        {
+          this->misses++;
+          while(this->cache.size()>=this->cacheCapacity) this->evict();
+          this->cache.emplace_front();
+          CacheEntry &entry=this->cache.front();
+          entry.index=index;
+          entry.dirty=false;
+          entry.tile.reallocate(this->tileWidth,this->tileHeight);
+          if(load) this->read_tile(entry);
+          this->cacheIndex[index]=this->cache.begin();
+        }
+      }
+      if(modify) this->cache.front().dirty=true;
+      return(this->cache.front().tile);
+    }
+    void read_tile(CacheEntry &entry)
+    {
+      this->file.clear();
+      this->file.seekg(this->tile_offset(entry.index));
+      this->file.read((char*)entry.tile.buffer,this->tile_bytes());
+      //Tiles, which were never written, are not stored in the file and they are filled by zeros
+      this->file.clear();
+    }
+    void write_back(CacheEntry &entry)
+    {
+      if(entry.dirty)
+      {
+        this->file.clear();
+        this->file.seekp(this->tile_offset(entry.index));
+        this->file.write((const char*)entry.tile.buffer,this->tile_bytes());
+        if(!this->file.good())
+        {
+          this->file.clear();
+          throw(CoreException("Error: [TiledImage::write_back]: Cannot write tile "+std::to_string(entry.index)+" to the file."));
+        }
+        entry.dirty=false;
+        this->writebacks++;
+      }
+    }
+    ///@throw CoreException if the evicted tile is dirty and it cannot be written, it then stays in the cache.
+    void evict()
+    {
+      CacheEntry &entry=this->cache.back();
+      this->write_back(entry);
+      this->cacheIndex.erase(entry.index);
+      this->cache.pop_back();
+      this->evictions++;
+    }
+    /** Call _f_ for each tile, which intersects rectangle \[_x1_,_y1_\]-\[_x2_,_y2_\].
+     *  @param f A callable with arguments (tile_type &tile,int tileOffsetX,int tileOffsetY,int x1,int y1,int x2,int y2),
+     *           where \[x1,y1\]-\[x2,y2\] is the intersection in the coordinates of the tile.
+     *  @param skipLoadOfCoveredTiles If true, the tiles completely covered by the rectangle are not read from the file.
+     */
+    template <class F> void for_each_tile(int x1,int y1,int x2,int y2,bool modify,bool load,F f,bool skipLoadOfCoveredTiles=false)
+    {
+      for(int ty=y1/this->tileHeight;ty<=y2/this->tileHeight;ty++)
+      {
+        for(int tx=x1/this->tileWidth;tx<=x2/this->tileWidth;tx++)
+        {
+          int ox=tx*this->tileWidth,oy=ty*this->tileHeight;
+          int tx1=std::max(x1-ox,0),ty1=std::max(y1-oy,0);
+          int tx2=std::min(x2-ox,this->tileWidth-1),ty2=std::min(y2-oy,this->tileHeight-1);
+          bool covered=tx1==0 && ty1==0 && tx2==std::min(this->tileWidth,this->width-ox)-1 && ty2==std::min(this->tileHeight,this->height-oy)-1;
+          f(this->fetch(tx,ty,modify,load && !(skipLoadOfCoveredTiles && covered)),ox,oy,tx1,ty1,tx2,ty2);
+        }
+      }
+    }
+  };
+}
+#endif
@@ -0,0 +1,280 @@
+#ifndef LIB_IMAGE_SEGMENTATION_VOLUME_H
+#define LIB_IMAGE_SEGMENTATION_VOLUME_H
+#include <numeric>
+#include "Dataset.h"
+#include "Parallel.h"
+#include "Scanline.h"
+namespace LibImageSegmentation
+{
+  /** 3D segmentation/image stored as a stack of slices in one contiguous block of memory.
+   *  The slices are the samples of a Dataset, so voxel \[x,y,z\] is at index (_z_*height+_y_)*width+_x_ and slice _z_
+   *  is accessed through the view (*this)\[_z_\] (see ImageView), which provides the 2D operations of ImageSegmentation
+   *  without copying. Multi-page TIFF files are loaded and saved page by page (see ScanlineReader), so only one row
+   *  of the file is kept in memory besides the volume.
+   * @tparam T Underlying type.
+   * @tparam N Number of channels.
+   */
+  template <class T,int N> class Volume : public Dataset<T,N>
+  {
+    public:
+    ///@see ImageSegmentation::color_type
+    using color_type=typename Dataset<T,N>::color_type;
+    ///Number of channels.
+    static constexpr int spectrum=N<=1?1:N;
+    /** Constructor.
+     *  Creates an empty volume.
+     */
+    Volume(){}
+    /** Constructor.
+     *  Creates a volume of size \[_width_,_height_,_depth_\] filled by zeros.
+     */
+    Volume(int width,int height,int depth) : Dataset<T,N>(depth,width,height){}
+    /** Constructor.
+     *  Loads the volume from file _filename_.
+     *  @see load
+     */
+    Volume(const std::string &filename){this->load(filename);}
+    ///Number of slices.
+    int depth()const{return(this->numofSamples);}
+    ///Number of voxels.
+    std::size_t numof_voxels()const{return(this->numofSamples*this->sample_pixels());}
+    ///Returns true if voxel \[_x_,_y_,_z_\] lies inside the volume.
+    bool is_voxel_inside(int x,int y,int z)const{return(x>=0 && y>=0 && z>=0 && x<this->width && y<this->height && z<this->numofSamples);}
+    ///Voxel \[_x_,_y_,_z_\].
+    color_type& operator()(int x,int y,int z){return(this->sample_buffer(z)[RowMajor::offset(x,y,this->width)]);}
+    ///@see operator()(int x,int y,int z)
+    const color_type& operator()(int x,int y,int z)const{return(this->sample_buffer(z)[RowMajor::offset(x,y,this->width)]);}
+    //-------------------------------------------------------------------------
+    /** Load the volume from file _filename_, one slice per page of a multi-page TIFF file.
+     *  The pages are decoded one after another, only one row of the file is kept in memory. The samples are converted
+     *  by a cast. Volumes with N>1 channels take the channels of the file (gray pages fill all channels, the missing
+     *  channels are 0), the others take the first channel. Files of other formats and TIFF files which cannot be
+     *  streamed (see ScanlineFormat) are loaded as volumes with one slice.
+     *  @param format,delimiter,ignoreBlankLines @see ScanlineReader::ScanlineReader
+     *  @throw CoreException if the file cannot be opened or a page cannot be decoded.
+     *  @throw DimensionException if the pages have different sizes.
+     */
+    void load(const std::string &filename,ScanlineFormat format=ScanlineFormat::Auto,char delimiter=',',bool ignoreBlankLines=true)
+    {
+      ScanlineReader<T> reader(filename,format,delimiter,ignoreBlankLines);
+      this->reallocate(reader.numofPages,reader.width,reader.height);
+      std::vector<T> row;
+      for(int z=0;z<this->numofSamples;z++)
+      {
+        if(z>0 && !reader.next_page())
+        {
+          this->numofSamples=z;
+          this->buffer.resize(this->numof_voxels());
+          break;
+        }
+        if(reader.width!=this->width || reader.height!=this->height)
+          throw(DimensionException("Error: [Volume::load]: Page "+std::to_string(z)+" of "+filename+" has size "+std::to_string(reader.width)+"x"+
+                                   std::to_string(reader.height)+", the first page has size "+std::to_string(this->width)+"x"+std::to_string(this->height)+"."));
+        row.resize((std::size_t)reader.width*reader.spectrum);
+        color_type *dst=this->sample_buffer(z);
+        for(int y=0;y<this->height;y++,dst+=this->width)
+        {
+          reader.read_rows(row.data());
+          for(int x=0;x<this->width;x++) this->set_voxel_samples(dst[x],row.data()+(std::size_t)x*reader.spectrum,reader.spectrum);
+        }
+      }
+    }
+    /** Save the volume into file _filename_, one slice per page.
+     *  The slices are written one after another through ScanlineWriter<T>, so only TIFF files can store more than
+     *  one slice.
+     *  @throw CoreException if the file cannot be written or the format cannot store all slices.
+     */
+    void save(const std::string &filename,ScanlineFormat format=ScanlineFormat::Auto)const
+    {
+      ScanlineWriter<T> writer(filename,this->width,this->height,this->spectrum,format);
+      std::vector<T> row((std::size_t)this->width*this->spectrum);
+      for(int z=0;z<this->numofSamples;z++)
+      {
+        if(z>0) writer.next_page();
+        const color_type *src=this->sample_buffer(z);
+        for(int y=0;y<this->height;y++,src+=this->width)
+        {
+          for(int x=0;x<this->width;x++) this->get_voxel_samples(src[x],row.data()+(std::size_t)x*this->spectrum);
+          writer.write_rows(row.data());
+        }
+      }
+      writer.close();
+    }
+    //-------------------------------------------------------------------------
+    /** Return number of occurences of _l_ in the volume, the slices are counted on _numofThreads_ threads.
+     *  @param numofThreads Number of threads, values <=0 mean the number of hardware threads.
+     */
+    std::size_t count_label(const color_type &l,int numofThreads=0)const
+    {
+      std::vector<std::size_t> counts(this->numofSamples,0);
+      parallel_for(this->numofSamples,numofThreads,[&](int z)
+      {
+        const color_type *slice=this->sample_buffer(z);
+        counts[z]=(std::size_t)std::count(slice,slice+this->sample_pixels(),l);
+      });
+      return(std::accumulate(counts.begin(),counts.end(),(std::size_t)0));
+    }
+    //-------------------------------------------------------------------------
+    /** Flood fill algorithm, which does not change the volume.
+     *  The flooding proceeds in rounds: all slices reached by the previous round are flooded in parallel (2D flood fill
+     *  from the voxels reached in the slice) and the newly flooded voxels continue into the neighbouring slices
+     *  in the next round.
+     *  @param startX X coordinate of the starting point.
+     *  @param startY Y coordinate of the starting point.
+     *  @param startZ Index of the slice of the starting point.
+     *  @param equalsFunction A callable with two arguments of type const Volume<T,N>::color_type &,
+     *         that returns true if its parameters are considered equal and false otherwise.
+     *  @param resPixels Flooded pixels of each slice, resPixels\[_z_\] contains the pixels of slice _z_.
+     *  @param fullNeighborhood If true, the flooding considers 26-neighborhood of each voxel, false means 6-neighborhood.
+     *  @param numofThreads Number of threads, values <=0 mean the number of hardware threads.
+     */
+    template <class EqualsFunctionType>
+    void flood_fill(int startX,int startY,int startZ,
+                    EqualsFunctionType equalsFunction,
+                    std::vector<std::vector<Pixel<int> > > &resPixels,
+                    bool fullNeighborhood=false,
+                    int numofThreads=0)const
+    {
+      resPixels.assign(this->numofSamples,std::vector<Pixel<int> >());
+      if(!this->is_voxel_inside(startX,startY,startZ)) return;
+      const color_type sourceLabel=(*this)(startX,startY,startZ);
+      //visited voxels of each slice, allocated when the flooding reaches the slice
+      std::vector<std::vector<char> > visited(this->numofSamples);
+      std::vector<std::vector<Pixel<int> > > seeds(this->numofSamples);
+      //index of the first pixel of resPixels[z] flooded in the current round
+      std::vector<std::size_t> firstNew(this->numofSamples,0);
+      std::vector<char> reached(this->numofSamples,0);
+      std::vector<int> active(1,startZ);
+      seeds[startZ].emplace_back(startX,startY);
+      while(!active.empty())
+      {
+        parallel_for((int)active.size(),numofThreads,[&](int k)
+        {
+          int z=active[k];
+          std::vector<char> &v=visited[z];
+          std::vector<Pixel<int> > &res=resPixels[z];
+          if(v.empty()) v.assign(this->sample_pixels(),0);
+          const color_type *slice=this->sample_buffer(z);
+          auto add_pixel=[&](int x,int y)
+          {
+            std::size_t i=RowMajor::offset(x,y,this->width);
+            if(!v[i] && equalsFunction(slice[i],sourceLabel)) {v[i]=1;res.emplace_back(x,y);}
+          };
+          firstNew[z]=res.size();
+          for(auto &&it: seeds[z]) add_pixel(it.x,it.y);
+          seeds[z].clear();
+          for(std::size_t i=firstNew[z];i<res.size();i++)
+          {
+            Pixel<int> p=res[i];
+            if(p.x>0) add_pixel(p.x-1,p.y);
+            if(p.y>0) add_pixel(p.x,p.y-1);
+            if(p.x<this->width-1) add_pixel(p.x+1,p.y);
+            if(p.y<this->height-1) add_pixel(p.x,p.y+1);
+            if(fullNeighborhood)
+            {
+              if(p.x>0 && p.y>0) add_pixel(p.x-1,p.y-1);
+              if(p.x>0 && p.y<this->height-1) add_pixel(p.x-1,p.y+1);
+              if(p.x<this->width-1 && p.y>0) add_pixel(p.x+1,p.y-1);
+              if(p.x<this->width-1 && p.y<this->height-1) add_pixel(p.x+1,p.y+1);
+            }
+          }
+        });
+        //slices adjacent to the flooded ones receive the seeds of the next round
+        for(auto &&z: active) reached[z]=1;
+        std::vector<int> targets;
+        for(auto &&z: active)
+        {
+          if(z>0) targets.push_back(z-1);
+          if(z<this->numofSamples-1) targets.push_back(z+1);
+        }
+        std::sort(targets.begin(),targets.end());
+        targets.erase(std::unique(targets.begin(),targets.end()),targets.end());
+        parallel_for((int)targets.size(),numofThreads,[&](int k)
+        {
+          int z=targets[k];
+          const std::vector<char> &v=visited[z];
+          const color_type *slice=this->sample_buffer(z);
+          std::vector<Pixel<int> > &s=seeds[z];
+          auto add_seed=[&](int x,int y)
+          {
+            std::size_t i=RowMajor::offset(x,y,this->width);
+            if((v.empty() || !v[i]) && equalsFunction(slice[i],sourceLabel)) s.emplace_back(x,y);
+          };
+          for(int source=z-1;source<=z+1;source+=2)
+          {
+            if(source<0 || source>=this->numofSamples || !reached[source]) continue;
+            const std::vector<Pixel<int> > &res=resPixels[source];
+            for(std::size_t i=firstNew[source];i<res.size();i++)
+            {
+              const Pixel<int> &p=res[i];
+              if(!fullNeighborhood) add_seed(p.x,p.y);
+              else
+              {
+                for(int y=std::max(p.y-1,0);y<=std::min(p.y+1,this->height-1);y++)
+                  for(int x=std::max(p.x-1,0);x<=std::min(p.x+1,this->width-1);x++) add_seed(x,y);
+              }
+            }
+          }
+        });
+        for(auto &&z: active) reached[z]=0;
+        active.clear();
+        for(auto &&z: targets) if(!seeds[z].empty()) active.push_back(z);
+      }
+    }
+    /** Flood fill algorithm, which does not change the volume.
+     *  @see flood_fill(int startX,int startY,int startZ,EqualsFunctionType equalsFunction,std::vector<std::vector<Pixel<int> > > &resPixels,bool fullNeighborhood,int numofThreads)const
+     */
+    void flood_fill(int startX,int startY,int startZ,
+                    std::vector<std::vector<Pixel<int> > > &resPixels,
+                    bool fullNeighborhood=false,
+                    int numofThreads=0)const
+    {
+      auto equalsFunction=[](const color_type &c1,const color_type &c2){return(c1==c2);};
+      this->flood_fill(startX,startY,startZ,equalsFunction,resPixels,fullNeighborhood,numofThreads);
+    }
+    /** Flood fill algorithm, the color of the flooded voxels is set to _targetLabel_ (in parallel by slices).
+     *  @see flood_fill(int startX,int startY,int startZ,EqualsFunctionType equalsFunction,std::vector<std::vector<Pixel<int> > > &resPixels,bool fullNeighborhood,int numofThreads)const
+     */
+    template <class EqualsFunctionType>
+    void flood_fill(int startX,int startY,int startZ,
+                    const color_type &targetLabel,
+                    EqualsFunctionType equalsFunction,
+                    std::vector<std::vector<Pixel<int> > > &resPixels,
+                    bool fullNeighborhood=false,
+                    int numofThreads=0)
+    {
+      const Volume<T,N> &self=*this;
+      self.flood_fill(startX,startY,startZ,equalsFunction,resPixels,fullNeighborhood,numofThreads);
+      parallel_for(this->numofSamples,numofThreads,[&](int z)
+      {
+        color_type *slice=this->sample_buffer(z);
+        for(auto &&it: resPixels[z]) slice[RowMajor::offset(it.x,it.y,this->width)]=targetLabel;
+      });
+    }
+    /** Flood fill algorithm, the color of the flooded voxels is set to _targetLabel_ (in parallel by slices).
+     *  @see flood_fill(int startX,int startY,int startZ,EqualsFunctionType equalsFunction,std::vector<std::vector<Pixel<int> > > &resPixels,bool fullNeighborhood,int numofThreads)const
+     */
+    void flood_fill(int startX,int startY,int startZ,
+                    const color_type &targetLabel,
+                    std::vector<std::vector<Pixel<int> > > &resPixels,
+                    bool fullNeighborhood=false,
+                    int numofThreads=0)
+    {
+      auto equalsFunction=[](const color_type &c1,const color_type &c2){return(c1==c2);};
+      this->flood_fill(startX,startY,startZ,targetLabel,equalsFunction,resPixels,fullNeighborhood,numofThreads);
+    }
+    //-------------------------------------------------------------------------
+    protected:
+    template <int NN=N> typename std::enable_if<(NN>1),void>::type set_voxel_samples(color_type &dst,const T *src,int spectrum)const
+    {
+      for(int c=0;c<N;c++) dst[c]=spectrum==1?src[0]:(c<spectrum?src[c]:T(0));
+    }
+    template <int NN=N> typename std::enable_if<(NN<=1),void>::type set_voxel_samples(color_type &dst,const T *src,int)const{dst=src[0];}
+    template <int NN=N> typename std::enable_if<(NN>1),void>::type get_voxel_samples(const color_type &src,T *dst)const
+    {
+      for(int c=0;c<N;c++) dst[c]=src[c];
+    }
+    template <int NN=N> typename std::enable_if<(NN<=1),void>::type get_voxel_samples(const color_type &src,T *dst)const{dst[0]=src;}
+  };
+}
+#endif
@@ -0,0 +1,49 @@
+/** Compares ColumnMajor and RowMajor images on load, save, save_csv and conv2.
+ *  Usage: layout_benchmark [size [directory]], the images have size*size pixels (default 2000) and the temporary
+ *  files are written into _directory_ (default the current directory).
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "ImageSegmentation.h"
+using namespace LibImageSegmentation;
+namespace
+{
+  ///Milliseconds spent by _f_.
+  template <class F> double measure(F f)
+  {
+    auto start=std::chrono::steady_clock::now();
+    f();
+    return(std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count());
+  }
+  template <class Layout> void run(const char *name,int size,const std::string &directory)
+  {
+    std::string png=directory+"/layout_benchmark.png",csv=directory+"/layout_benchmark.csv";
+    ImageSegmentation<double,1,Layout> img(size,size,Verbose::Silent),loaded(Verbose::Silent),filter(7,7,Verbose::Silent);
+    img.traverse([&](int x,int y){img.data[x][y]=(x*y)%255;});
+    filter.init_data(1.0/49.0);
+    //a filter of rank > 1, so that conv2 uses the direct convolution
+    filter.data[0][0]=0;
+    double save=measure([&](){img.save(png);});
+    double load=measure([&](){loaded.load(png);});
+    double saveCsv=measure([&](){img.save_csv(csv,',',1);});
+    double conv2=measure([&](){img.conv2(filter,true,Conv2Method::Direct,1);});
+    std::printf("%-12s save %8.0f ms, load %8.0f ms, save_csv %8.0f ms, conv2 7x7 %8.0f ms\n",name,save,load,saveCsv,conv2);
+    std::remove(png.c_str());
+    std::remove(csv.c_str());
+  }
+}
+int main(int argc,char **argv)
+{
+  int size=argc>1?std::atoi(argv[1]):2000;
+  std::string directory=argc>2?argv[2]:".";
+  if(size<=0)
+  {
+    std::fprintf(stderr,"Usage: %s [size [directory]]\n",argv[0]);
+    return(1);
+  }
+  run<ColumnMajor>("ColumnMajor",size,directory);
+  run<RowMajor>("RowMajor",size,directory);
+  return(0);
+}